@@ -0,0 +1,256 @@
+#!/usr/bin/env python
+
+"""Runs symdivine on a corpus of *.ll models in parallel and records
+per-job resource usage and statistics to a CSV file. Optionally compares the
+results against a baseline CSV produced by an earlier run and reports
+performance regressions (the exit code is 1 if there are any).
+
+Every job is limited by prlimit (CPU time, address space) and by a wall
+clock timeout, and runs in its own session (setsid), so the timeout kills its
+whole process group. Both tools come from util-linux. Time and memory are
+measured for each job separately by wait4, states, solver calls and cache hits
+come from --stats-json.
+
+Example:
+    bench_parallel.py ../bin/symdivine benchmarks/ -j 4 -o new.csv \\
+        --baseline=old.csv --symdivine-args="-c --partialstore"
+"""
+
+from __future__ import print_function
+
+import argparse
+import csv
+import json
+import os
+import shlex
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+try:
+    from queue import Queue
+except ImportError:
+    from Queue import Queue
+
+COLUMNS = ["model", "result", "wall", "cpu", "rss_mb", "states",
+           "solver_calls", "cache_hits"]
+
+# Metrics checked for regressions and absolute differences which are
+# considered noise regardless of the relative tolerance
+REGRESSION_METRICS = [("wall", 0.5), ("cpu", 0.5), ("rss_mb", 16.0),
+                      ("states", 0), ("solver_calls", 0)]
+
+def find_models(paths):
+    models = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, files in os.walk(path):
+                models += [os.path.join(root, f) for f in files if f.endswith(".ll")]
+        else:
+            models.append(path)
+    # Normalized paths are the keys for the baseline comparison
+    models = [os.path.normpath(m) for m in models]
+    return sorted(models)
+
+def limit_command(cmd, cpu_limit, mem_limit):
+    """Prefixes the command by setsid and prlimit. Both exec the command in
+    the same process, so its pid and resource usage stay those of the job.
+    preexec_fn is not used, it is not safe with the worker threads."""
+    prefix = ["setsid", "prlimit"]
+    if cpu_limit:
+        # The soft limit sends SIGXCPU, the hard one SIGKILL
+        prefix.append("--cpu=%d:%d" % (cpu_limit, cpu_limit + 1))
+    if mem_limit:
+        prefix.append("--as=%d" % (mem_limit * 1024 * 1024))
+    return prefix + ["--"] + cmd
+
+def classify(status, timed_out, cpu_time, cpu_limit, output):
+    if timed_out:
+        return "TIMEOUT"
+    if os.WIFSIGNALED(status):
+        sig = os.WTERMSIG(status)
+        if sig == signal.SIGXCPU:
+            return "TIMEOUT"
+        if sig == signal.SIGKILL:
+            # Either the hard CPU limit or the OOM killer
+            if cpu_limit and cpu_time >= cpu_limit:
+                return "TIMEOUT"
+            return "OUT OF MEMORY"
+        return "ERROR"
+    if "bad_alloc" in output:
+        return "OUT OF MEMORY"
+    if os.WEXITSTATUS(status) != 0:
+        return "ERROR"
+    if "Safe." in output or "Property holds" in output:
+        return "TRUE"
+    if "Error state" in output or "Property violated" in output:
+        return "FALSE"
+    return "UNKNOWN"
+
+def run_job(symdivine, model, args, limits):
+    cpu_limit, mem_limit, wall_limit = limits
+    tmpdir = tempfile.mkdtemp(prefix="symdivine-bench.")
+    stats_file = os.path.join(tmpdir, "stats.json")
+    out_file = os.path.join(tmpdir, "output")
+    cmd = [symdivine] + args + ["--stats-json=" + stats_file, model]
+    try:
+        with open(out_file, "w+") as out:
+            start = time.time()
+            p = subprocess.Popen(limit_command(cmd, cpu_limit, mem_limit),
+                                 stdout=out, stderr=subprocess.STDOUT)
+            timed_out = []
+            def kill():
+                timed_out.append(True)
+                try:
+                    os.killpg(p.pid, signal.SIGKILL)
+                except OSError:
+                    pass
+            timer = threading.Timer(wall_limit, kill) if wall_limit else None
+            if timer:
+                timer.start()
+            # wait4 gives the resource usage of this job only, unlike
+            # RUSAGE_CHILDREN which sums all finished children
+            _, status, usage = os.wait4(p.pid, 0)
+            p.returncode = status
+            wall = time.time() - start
+            if timer:
+                timer.cancel()
+            out.seek(0)
+            output = out.read()
+
+        cpu = usage.ru_utime + usage.ru_stime
+        row = {
+            "model": model,
+            "result": classify(status, bool(timed_out), cpu, cpu_limit, output),
+            "wall": "%.3f" % wall,
+            "cpu": "%.3f" % cpu,
+            # ru_maxrss is in kilobytes on Linux
+            "rss_mb": "%.1f" % (usage.ru_maxrss / 1024.0),
+            "states": "", "solver_calls": "", "cache_hits": ""
+        }
+        if os.path.exists(stats_file):
+            try:
+                with open(stats_file) as f:
+                    stats = json.load(f)
+                for key in ["states", "solver_calls", "cache_hits"]:
+                    row[key] = stats.get(key, "")
+            except ValueError:
+                pass # Killed while writing the statistics
+        return row
+    finally:
+        shutil.rmtree(tmpdir, ignore_errors=True)
+
+def run_all(symdivine, models, args, limits, jobs):
+    queue = Queue()
+    for m in models:
+        queue.put(m)
+    results = {}
+    lock = threading.Lock()
+
+    def worker():
+        while True:
+            try:
+                model = queue.get_nowait()
+            except Exception:
+                return
+            row = run_job(symdivine, model, args, limits)
+            with lock:
+                results[model] = row
+                print("{:<60} {:<14} {:>9}s {:>9} MB".format(
+                    model, row["result"], row["wall"], row["rss_mb"]))
+                sys.stdout.flush()
+
+    threads = [threading.Thread(target=worker) for _ in range(jobs)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return [results[m] for m in models]
+
+def write_csv(filename, rows):
+    with open(filename, "w") as f:
+        writer = csv.DictWriter(f, fieldnames=COLUMNS)
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+def read_csv(filename):
+    with open(filename) as f:
+        return dict((row["model"], row) for row in csv.DictReader(f))
+
+def compare(rows, baseline, tolerance):
+    """Returns list of regression descriptions"""
+    regressions = []
+    for row in rows:
+        base = baseline.get(row["model"])
+        if base is None:
+            continue
+        if row["result"] != base["result"]:
+            regressions.append("{}: result {} -> {}".format(
+                row["model"], base["result"], row["result"]))
+            continue
+        for metric, noise in REGRESSION_METRICS:
+            try:
+                old = float(base[metric])
+                new = float(row[metric])
+            except (ValueError, TypeError, KeyError):
+                continue # Missing in one of the runs
+            if new > old * (1 + tolerance) and new - old > noise:
+                regressions.append("{}: {} {} -> {} ({:+.0f}%)".format(
+                    row["model"], metric, base[metric], row[metric],
+                    100.0 * (new - old) / old if old else float("inf")))
+    return regressions
+
+def parse_args():
+    p = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("symdivine", help="symdivine binary")
+    p.add_argument("corpus", nargs="+", help="*.ll files or directories")
+    p.add_argument("-j", "--jobs", type=int, default=0,
+        help="number of parallel jobs, 0 for all cores (default)")
+    p.add_argument("-o", "--output", default="benchmark.csv",
+        help="output CSV file (default: benchmark.csv)")
+    p.add_argument("--baseline", help="CSV of a previous run to compare with")
+    p.add_argument("--tolerance", type=float, default=10.0,
+        help="allowed slowdown against the baseline in percent (default: 10)")
+    p.add_argument("--cpu-limit", type=int, default=900,
+        help="CPU time limit per job in seconds (default: 900)")
+    p.add_argument("--mem-limit", type=int, default=0,
+        help="address space limit per job in MB, 0 for none (default)")
+    p.add_argument("--wall-limit", type=int, default=0,
+        help="wall time limit per job in seconds, 0 for none (default)")
+    p.add_argument("--symdivine-args", default="reachability",
+        help="arguments passed to symdivine (default: reachability)")
+    return p.parse_args()
+
+if __name__ == "__main__":
+    a = parse_args()
+    models = find_models(a.corpus)
+    if not models:
+        print("No models found")
+        sys.exit(1)
+
+    args = shlex.split(a.symdivine_args)
+    if "reachability" not in args and "ltl" not in args:
+        args = ["reachability"] + args
+    jobs = a.jobs
+    if jobs <= 0:
+        import multiprocessing
+        jobs = multiprocessing.cpu_count()
+
+    rows = run_all(a.symdivine, models, args,
+                   (a.cpu_limit, a.mem_limit, a.wall_limit), jobs)
+    write_csv(a.output, rows)
+
+    if a.baseline:
+        regressions = compare(rows, read_csv(a.baseline), a.tolerance / 100.0)
+        if regressions:
+            print("\n=== REGRESSIONS")
+            for r in regressions:
+                print(r)
+            sys.exit(1)
+        print("\nNo regressions against " + a.baseline)
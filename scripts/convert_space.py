@@ -0,0 +1,162 @@
+#!/usr/bin/env python
+
+"""Usage: convert_space.py <input> <output> [--graphml]
+
+Converts state space streamed by symdivine --space_stream=<file> to DOT
+(default) or GraphML format.
+
+Arguments:
+    <input>     binary state space produced by symdivine
+    <output>    output file
+
+Options:
+    --graphml   output GraphML instead of DOT
+"""
+
+import sys
+import struct
+from xml.sax.saxutils import escape
+
+HEADER = b"SymDIVINE space v1 "
+
+# Fill colors of LTL vertices indexed by the BA state
+LTL_COLORS = ["F16745", "FFC65D", "7BC8A4", "4CC3D9", "93648D"]
+REACHABILITY_COLOR = "FFC65D"
+
+VERTEX = struct.Struct("=QQII")
+EDGE = struct.Struct("=QQQQ")
+
+def read_records(f):
+    """Yields ('V', id, group, label) and ('E', from, to) records"""
+    while True:
+        tag = f.read(1)
+        if not tag:
+            return
+        if tag == b"V":
+            data = f.read(VERTEX.size)
+            if len(data) != VERTEX.size:
+                raise IOError("truncated vertex record")
+            exp_id, sym_id, group, label_size = VERTEX.unpack(data)
+            label = f.read(label_size).decode("utf-8", "replace")
+            yield ("V", (exp_id, sym_id), group, label)
+        elif tag == b"E":
+            data = f.read(EDGE.size)
+            if len(data) != EDGE.size:
+                raise IOError("truncated edge record")
+            r = EDGE.unpack(data)
+            yield ("E", (r[0], r[1]), (r[2], r[3]))
+        else:
+            raise IOError("unknown record {!r}".format(tag))
+
+def vertex_name(id):
+    return "E{}S{}".format(id[0], id[1])
+
+def color(kind, group):
+    if kind == "ltl":
+        if group < len(LTL_COLORS):
+            return LTL_COLORS[group]
+        return None
+    return REACHABILITY_COLOR
+
+class DotOutput:
+    def __init__(self, out, kind):
+        self.out = out
+        self.kind = kind
+        out.write("digraph state_space {\n")
+
+    def vertex(self, id, group, label):
+        if label is None:
+            label = "<{}, {}>".format(id[0], id[1])
+        label = label.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n")
+        style = ""
+        c = color(self.kind, group) if group is not None else None
+        if c:
+            style = " style=\"filled\" fillcolor=\"#{}\"".format(c)
+        self.out.write("\t{}[label=\"{}\"{}]\n".format(vertex_name(id), label, style))
+
+    def edge(self, frm, to):
+        self.out.write("\t{} -> {}\n".format(vertex_name(frm), vertex_name(to)))
+
+    def close(self):
+        self.out.write("\n}\n")
+
+class GraphMLOutput:
+    def __init__(self, out, kind):
+        self.out = out
+        self.kind = kind
+        out.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+            "  <key id=\"label\" for=\"node\" attr.name=\"label\" attr.type=\"string\"/>\n"
+            "  <key id=\"group\" for=\"node\" attr.name=\"group\" attr.type=\"int\"/>\n"
+            "  <key id=\"color\" for=\"node\" attr.name=\"color\" attr.type=\"string\"/>\n"
+            "  <graph id=\"state_space\" edgedefault=\"directed\">\n")
+
+    def vertex(self, id, group, label):
+        self.out.write("    <node id=\"{}\">\n".format(vertex_name(id)))
+        if label is not None:
+            self.out.write("      <data key=\"label\">{}</data>\n".format(escape(label)))
+        if group is not None:
+            self.out.write("      <data key=\"group\">{}</data>\n".format(group))
+            c = color(self.kind, group)
+            if c:
+                self.out.write("      <data key=\"color\">#{}</data>\n".format(c))
+        self.out.write("    </node>\n")
+
+    def edge(self, frm, to):
+        self.out.write("    <edge source=\"{}\" target=\"{}\"/>\n".format(
+            vertex_name(frm), vertex_name(to)))
+
+    def close(self):
+        self.out.write("  </graph>\n</graphml>\n")
+
+def convert(input, output, graphml):
+    with open(input, "rb") as f:
+        header = f.readline()
+        if not header.startswith(HEADER):
+            raise IOError("{} is not a SymDIVINE state space".format(input))
+        kind = header[len(HEADER):].strip().decode("ascii")
+
+        with open(output, "w") as o:
+            out = GraphMLOutput(o, kind) if graphml else DotOutput(o, kind)
+            # Edges of a vertex directly follow its vertex record. A vertex may
+            # be expanded repeatedly (e.g. by iterative deepening), then its
+            # edges are skipped, so only the vertices are kept in memory.
+            vertices = set()
+            unexpanded = set() # Targets without a vertex record so far
+            source = None      # Vertex whose edges are being read
+            repeated = False   # The source was expanded before
+            targets = set()    # Targets of the source
+            for record in read_records(f):
+                if record[0] == "V":
+                    source = record[1]
+                    repeated = source in vertices
+                    targets = set()
+                    if not repeated:
+                        vertices.add(source)
+                        unexpanded.discard(source)
+                        out.vertex(source, record[2], record[3] or None)
+                    continue
+                if record[1] != source:
+                    # Edge without a preceding vertex record
+                    source = record[1]
+                    repeated = False
+                    targets = set()
+                    if source not in vertices:
+                        unexpanded.add(source)
+                if repeated or record[2] in targets:
+                    continue
+                targets.add(record[2])
+                if record[2] not in vertices:
+                    unexpanded.add(record[2])
+                out.edge(record[1], record[2])
+            # Vertices which were reached but never expanded
+            for id in sorted(unexpanded):
+                out.vertex(id, None, None)
+            out.close()
+
+if __name__ == "__main__":
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    if len(args) != 2 or any(a not in ["--graphml"] for a in sys.argv[1:] if a.startswith("--")):
+        print(__doc__)
+        sys.exit(1)
+    convert(args[0], args[1], "--graphml" in sys.argv)
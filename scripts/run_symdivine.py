@@ -15,41 +15,20 @@ Options:
 
 import sys, os, subprocess
 import compile_to_bitcode
-import hashlib
 
 from tempfile import mkdtemp
 
-def produce_witness(benchmark, arch, type):
-    if type:
-        with open("witness-true-template.xml") as f:
-            witness = f.read()
-    else:
-        with open("witness-false-template.xml") as f:
-            witness = f.read()
-    with open(benchmark) as f:
-        src = f.read()
-    archname = "{}bit".format(arch)
-    hash = hashlib.sha1(src)
-    witness = witness.replace("{HASH}", hash.hexdigest())
-    witness = witness.replace("{PROGRAM}", benchmark)
-    witness =witness.replace("{ARCH}", archname)
-    with open("witness.xml", "w") as f:
-        f.write(witness)
-
 def run_symdivine(symdivine_location, benchmark, arch, src, symdivine_params = []):
     cmd = [os.path.join(symdivine_location, "symdivine"), "reachability"]
     cmd += [benchmark]
+    cmd += ["--witness=witness.xml", "--witness-program=" + src,
+        "--witness-arch={}bit".format(arch)]
     cmd += symdivine_params
     env = os.environ.copy()
     env["LD_LIBRARY_PATH"] = symdivine_location
     p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, env=env)
     stdout, stderr = p.communicate()
 
-    if "Error state" in stdout or "Error state" in stderr:
-        produce_witness(src, arch, False)
-    elif "Safe" in stdout:
-        produce_witness(src, arch, True)
-
     sys.stdout.write(stdout)
     sys.stderr.write(stderr)
 
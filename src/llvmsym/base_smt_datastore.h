@@ -3,12 +3,15 @@
 #include <llvmsym/datastore.h>
 #include <llvmsym/formula/rpn.h>
 #include <llvmsym/formula/z3.h>
+#include <llvmsym/formula/abstract.h>
 #include <llvmsym/programutils/statistics.h>
 #include <llvmsym/programutils/config.h>
 #include <vector>
 #include <list>
 #include <map>
 #include <set>
+#include <functional>
+#include <algorithm>
 #include <toolkit/utils.h>
 
 #define SUBSETEQ_CALLS "Subseteq queries"
@@ -19,6 +22,12 @@
 #define Q_SIMP "Q queries solved via simplification"
 #define Q_N_SIMP "Q queries solved via solver"
 #define SOLVER_UNKNOWN "Solver unknown"
+#define GC_REMOVED "Constraints removed by garbage collection"
+#define SUBSETEQ_INLINED "Definitions inlined in subseteq"
+#define SUBSETEQ_PROJECTED "Subseteq queries via projection"
+#define PROJECTIONS "Projections of stored states"
+#define PROJECTIONS_FAILED "Projections with quantifiers left"
+#define PROJECTIONS_SKIPPED "Projections skipped as failed before"
 
 namespace llvm_sym {
 
@@ -34,6 +43,312 @@ namespace llvm_sym {
         virtual void push_condition(const Formula &f) = 0;
         virtual void push_definition(Value symbol_id, const Formula &def) = 0;
 
+        /**
+         * Collects definitions and path conditions of all variables
+         */
+        virtual void collect_constraints(std::vector<Definition>& defs,
+            std::vector<Formula>& pcs) const = 0;
+
+        /**
+         * Moves per-segment data according to map (old id -> new id, -1 for
+         * dropped segments)
+         */
+        template <class T>
+        static void remap_segments(const std::vector<int>& map, std::vector<T>& v) {
+            int count = 0;
+            for (int m : map)
+                count = std::max(count, m + 1);
+
+            std::vector<T> res(count);
+            for (size_t s = 0; s < map.size(); ++s) {
+                if (map[s] != -1)
+                    res[map[s]] = std::move(v[s]);
+            }
+            v = std::move(res);
+        }
+
+        /**
+         * Decides by intervals and known bits that the constraints are
+         * certainly unsatisfiable, false means unknown
+         */
+        static bool abstract_empty(const std::vector<Definition>& defs,
+            const std::vector<Formula>& pcs)
+        {
+            static bool enabled = !Config.is_set("--disableintervals");
+            if (!enabled)
+                return false;
+            AbstractEnv env;
+            if (env.assume(defs, pcs))
+                return false;
+            ++Statistics::getCounter(ABSTRACT_EMPTY);
+            return true;
+        }
+
+        /**
+         * Pre-filter of subseteq, b is certainly not included in a if a
+         * compared variable has disjoint values in a and b. It expects b to
+         * be non-empty as the states in the database are, otherwise the
+         * state is only stored once more. False means unknown. The constraints
+         * of a are given either by value or by reference (AbstractEnv::assume).
+         */
+        template <class Defs, class Pcs>
+        static bool abstract_not_subseteq(const Defs& a_defs,
+            const Pcs& a_pcs, const std::vector<Definition>& b_defs,
+            const std::vector<Formula>& b_pcs,
+            const std::map<Formula::Ident, Formula::Ident>& to_compare)
+        {
+            static bool enabled = !Config.is_set("--disableintervals");
+            if (!enabled)
+                return false;
+            AbstractEnv a_env, b_env;
+            if (!b_env.assume(b_defs, b_pcs))
+                return false;
+            bool not_subseteq = !a_env.assume(a_defs, a_pcs);
+            for (const auto& vars : to_compare) {
+                if (not_subseteq)
+                    break;
+                not_subseteq = a_env.get(vars.first).disjoint(b_env.get(vars.second));
+            }
+            if (not_subseteq)
+                ++Statistics::getCounter(ABSTRACT_NOT_SUBSETEQ);
+            return not_subseteq;
+        }
+
+        /**
+         * One side of a subseteq query: constraints and the compared atoms
+         */
+        struct QuerySide {
+            std::vector<Formula> constraints;
+            std::vector<Formula> atoms;
+
+            /**
+             * Variables occurring in the query, i.e. the quantifier prefix
+             */
+            std::vector<Formula::Ident> variables() const {
+                std::vector<Formula::Ident> vars;
+                for (const auto& f : constraints)
+                    f.collect_variables(vars);
+                for (const auto& f : atoms)
+                    f.collect_variables(vars);
+                std::sort(vars.begin(), vars.end());
+                vars.erase(std::unique(vars.begin(), vars.end()), vars.end());
+                return vars;
+            }
+        };
+
+        /**
+         * Builds one side of a subseteq query. Definitions are functional, so
+         * the ones used at most once are substituted into their user and
+         * removed, their symbols disappear from the quantifier prefix.
+         * Definitions used more times stay as equalities to keep the formula
+         * small.
+         */
+        static QuerySide query_side(const std::vector<Definition>& defs,
+            const std::vector<Formula>& pcs, const std::vector<Formula::Ident>& atoms)
+        {
+            QuerySide res;
+            res.constraints = pcs;
+            for (const auto& id : atoms)
+                res.atoms.push_back(Formula::buildIdentifier(id));
+
+            std::map<Formula::Ident, int> uses;
+            auto count_uses = [&](const Formula& f, int delta) {
+                std::vector<Formula::Ident> vars;
+                f.collect_variables(vars);
+                for (const auto& id : vars)
+                    uses[id] += delta;
+            };
+            for (const auto& f : res.constraints)
+                count_uses(f, 1);
+            for (const auto& f : res.atoms)
+                count_uses(f, 1);
+            for (const auto& def : defs)
+                count_uses(def.def, 1);
+
+            std::vector<Definition> rest(defs);
+            bool change;
+            do {
+                change = false;
+                for (size_t i = 0; i < rest.size(); ) {
+                    const Definition def = rest[i];
+                    int use_count = uses[def.symbol];
+                    if (use_count > 1) {
+                        ++i;
+                        continue;
+                    }
+                    rest.erase(rest.begin() + i);
+                    change = true;
+                    ++Statistics::getCounter(SUBSETEQ_INLINED);
+                    if (use_count == 0) {
+                        count_uses(def.def, -1);
+                        continue;
+                    }
+                    // The uses of the variables of def move to its only user
+                    for (auto& f : res.constraints)
+                        f = f.substitute(def.symbol, def.def);
+                    for (auto& f : res.atoms)
+                        f = f.substitute(def.symbol, def.def);
+                    for (auto& d : rest)
+                        d = d.substitute(def.symbol, def.def);
+                    uses[def.symbol] = 0;
+                }
+            } while (change);
+
+            for (const auto& def : rest)
+                res.constraints.push_back(def.to_formula());
+            return res;
+        }
+
+        /**
+         * Cone-of-influence garbage collection. Removes constraints which
+         * cannot influence the current generations of the variables (the live
+         * ones):
+         *  - components of the constraints (connected by shared variables)
+         *    without a live variable. The state is satisfiable, so such a
+         *    component is satisfiable too and it projects to true,
+         *  - definitions of dead variables not used by other constraints,
+         *    exists x. x = e is always true.
+         * Returns the number of removed constraints.
+         */
+        static size_t collect_garbage(const std::vector<short unsigned>& segments_mapping,
+            const std::vector<std::vector<short unsigned>>& generations,
+            std::vector<Definition>& defs, std::vector<Formula>& pcs)
+        {
+            typedef std::pair<short unsigned, short unsigned> Var;
+            std::map<Var, short unsigned> current;
+            for (size_t s = 0; s < generations.size(); ++s) {
+                for (size_t o = 0; o < generations[s].size(); ++o)
+                    current[Var(segments_mapping[s], o)] = generations[s][o];
+            }
+            auto is_live = [&](const Formula::Ident& id) {
+                auto it = current.find(Var(id.seg, id.off));
+                return it != current.end() && it->second == id.gen;
+            };
+
+            // Union-find over the variables, every constraint joins its variables
+            std::map<Formula::Ident, size_t> index;
+            std::vector<size_t> parent;
+            std::function<size_t(size_t)> find = [&](size_t i) {
+                return parent[i] == i ? i : parent[i] = find(parent[i]);
+            };
+            auto node = [&](const Formula::Ident& id) {
+                auto it = index.insert({ id, parent.size() });
+                if (it.second)
+                    parent.push_back(parent.size());
+                return it.first->second;
+            };
+
+            // Constraints are indexed definitions first, then path conditions
+            size_t def_count = defs.size();
+            size_t count = def_count + pcs.size();
+            std::vector<std::vector<Formula::Ident>> vars(count);
+            for (size_t i = 0; i < def_count; ++i)
+                defs[i].collect_variables(vars[i]);
+            for (size_t i = 0; i < pcs.size(); ++i)
+                pcs[i].collect_variables(vars[def_count + i]);
+            for (const auto& v : vars) {
+                for (const auto& id : v)
+                    node(id);
+            }
+            for (const auto& v : vars) {
+                for (const auto& id : v) {
+                    size_t root = find(index[v.front()]);
+                    parent[root] = find(index[id]);
+                }
+            }
+
+            std::set<size_t> live_roots;
+            for (const auto& item : index) {
+                if (is_live(item.first))
+                    live_roots.insert(find(item.second));
+            }
+
+            // Constraints without variables are kept, false makes the state empty
+            std::vector<bool> keep(count);
+            std::map<Formula::Ident, int> uses;
+            for (size_t i = 0; i < count; ++i) {
+                keep[i] = vars[i].empty() || live_roots.count(find(index[vars[i].front()]));
+                if (!keep[i])
+                    continue;
+                for (const auto& id : vars[i])
+                    ++uses[id];
+            }
+
+            bool change;
+            do {
+                change = false;
+                for (size_t i = 0; i < def_count; ++i) {
+                    const auto& symbol = defs[i].symbol;
+                    // The symbol itself is one of the uses
+                    if (!keep[i] || is_live(symbol) || uses[symbol] > 1)
+                        continue;
+                    keep[i] = false;
+                    change = true;
+                    for (const auto& id : vars[i])
+                        --uses[id];
+                }
+            } while (change);
+
+            std::vector<Definition> new_defs;
+            for (size_t i = 0; i < def_count; ++i) {
+                if (keep[i])
+                    new_defs.push_back(std::move(defs[i]));
+            }
+            std::vector<Formula> new_pcs;
+            for (size_t i = 0; i < pcs.size(); ++i) {
+                if (keep[def_count + i])
+                    new_pcs.push_back(std::move(pcs[i]));
+            }
+            size_t removed = count - new_defs.size() - new_pcs.size();
+            defs = std::move(new_defs);
+            pcs = std::move(new_pcs);
+            return removed;
+        }
+
+        typedef std::function<void(Formula::Ident&)> IdentVisitor;
+
+        /**
+         * Renumbers generations of every variable to 0, 1, ... keeping their
+         * order, so equivalent states reached by paths of different lengths
+         * are equal syntactically. visit has to call its argument on every
+         * identifier of the store.
+         */
+        static void renumber_generations(const std::vector<short unsigned>& segments_mapping,
+            std::vector<std::vector<short unsigned>>& generations,
+            const std::function<void(const IdentVisitor&)>& visit)
+        {
+            typedef std::pair<short unsigned, short unsigned> Var;
+            std::map<Var, std::vector<short unsigned>> used;
+            for (size_t s = 0; s < generations.size(); ++s) {
+                for (size_t o = 0; o < generations[s].size(); ++o)
+                    used[Var(segments_mapping[s], o)].push_back(generations[s][o]);
+            }
+            visit([&](Formula::Ident& id) {
+                used[Var(id.seg, id.off)].push_back(id.gen);
+            });
+
+            bool compact = true;
+            for (auto& u : used) {
+                std::sort(u.second.begin(), u.second.end());
+                u.second.erase(std::unique(u.second.begin(), u.second.end()), u.second.end());
+                compact = compact && u.second.back() == u.second.size() - 1;
+            }
+            if (compact)
+                return;
+
+            auto rank = [&](const Var& var, short unsigned gen) -> short unsigned {
+                const auto& gens = used[var];
+                return std::lower_bound(gens.begin(), gens.end(), gen) - gens.begin();
+            };
+            for (size_t s = 0; s < generations.size(); ++s) {
+                for (size_t o = 0; o < generations[s].size(); ++o)
+                    generations[s][o] = rank(Var(segments_mapping[s], o), generations[s][o]);
+            }
+            visit([&](Formula::Ident& id) {
+                id.gen = rank(Var(id.seg, id.off), id.gen);
+            });
+        }
+
     public:
         virtual void implement_add(Value result_id, Value a_id, Value b_id) final {
             Formula a_expr = build_expression(a_id);
@@ -172,6 +487,43 @@ namespace llvm_sym {
             get_generation(input_variable, true);
         }
 
+        /**
+         * Prints values of the input variables in a model of the path
+         * condition, used for counterexamples
+         * @return false if the path condition is unsatisfiable
+         */
+        bool dump_model(std::ostream& o) const {
+            std::vector<Definition> defs;
+            std::vector<Formula> pcs;
+            collect_constraints(defs, pcs);
+
+            z3::context c;
+            z3::solver s(c);
+            std::set<std::string> defined;
+            for (const Definition& def : defs) {
+                s.add(toz3(def.to_formula(), 'a', c));
+                z3::expr symbol = toz3(Formula::buildIdentifier(def.getIdent()), 'a', c);
+                defined.insert(symbol.decl().name().str());
+            }
+            for (const Formula& pc : pcs)
+                s.add(toz3(pc, 'a', c));
+
+            if (s.check() != z3::sat)
+                return false;
+
+            z3::model m = s.get_model();
+            for (unsigned i = 0; i != m.size(); i++) {
+                z3::func_decl var = m[i];
+                std::string name = var.name().str();
+                if (var.arity() != 0 || defined.count(name))
+                    continue;
+                z3::expr value = m.get_const_interp(var);
+                o << "  " << name.substr(2) << " = "
+                  << Z3_get_numeral_string(c, value) << "\n";
+            }
+            return true;
+        }
+
         bool equal(const StoreType& snd) {
             return subseteq(*this, snd) && subseteq(snd, *this);
         }
@@ -3,8 +3,11 @@
 #include "toolkit/hash.h"
 #include "llvmsym/smtdatastore.h"
 #include "toolkit/utils.h"
+#include "toolkit/chunk_pool.h"
+#include "toolkit/disk_store.h"
 
 #include <unordered_map>
+#include <list>
 #include <set>
 #include <unordered_set>
 #include <vector>
@@ -102,39 +105,6 @@ private:
     size_t explicit_size;
 };
 
-struct blobHashExplicitPart {
-    size_t operator()(const Blob &b) const {
-        hash128_t h = spookyHash(reinterpret_cast<void*>(b.getExpl()),
-            b.getExplSize(), 0, 0);
-        return h.first ^ h.second;
-    }
-};
-
-struct blobEqualExplicitPart {
-    bool operator()(const Blob &b1, const Blob &b2) const {
-        if (b1.getExplSize() != b2.getExplSize())
-            return false;
-        return memcmp(b1.getExpl(), b2.getExpl(), b1.getExplSize()) == 0;
-    }
-};
-
-struct blobHashExplicitUserPart {
-    size_t operator()(const Blob &b) const {
-        hash128_t h = spookyHash(reinterpret_cast<void*>(b.getUser()),
-            b.getExplSize() + b.getUserSize(), 0, 0);
-        return h.first ^ h.second;
-    }
-};
-
-struct blobEqualExplicitUserPart {
-    bool operator()(const Blob &b1, const Blob &b2) const {
-        if (b1.getExplSize() != b2.getExplSize()
-         || b1.getUserSize() != b2.getUserSize())
-            return false;
-        return memcmp(b1.getUser(), b2.getUser(), b1.getExplSize() + b2.getUserSize()) == 0;
-    }
-};
-
 /**
  * Identifier for states
  */
@@ -186,21 +156,55 @@ public:
     DatabaseException(const std::string& msg) : std::runtime_error(msg) { }
 };
 
+/**
+ * Database of states. Explicit parts (including the user part) are stored
+ * tree-compressed - as a sequence of references to hash-consed chunks. The
+ * chunk boundaries are given by the caller on insertion and have to be
+ * deterministic for the given content (see Evaluator::getExplicitChunks).
+ *
+ * When a memory limit is set, symbolic containers of the least recently used
+ * explicit items are spilled to a temporary file and loaded back on access.
+ * The limit covers the resident containers, the formulas they refer to and
+ * the explicit parts, only the symbolic containers can be spilled though.
+ * The explicit keys, the chunk and formula pools and the structures of the
+ * caller (e.g. the successor lists of the LTL graph) always stay resident.
+ */
 template<typename ExplState, typename SymbState,  typename SymbContainer,
-    typename ExplHasher, typename ExplEqual, typename Id = size_t>
+    typename Id = size_t>
 class Database {
 public:
     typedef typename StateId::IdType IdType;
+    typedef std::vector<size_t> Chunks;
+
+    Database() : id_counter(0), state_count(0), mem_limit(0), resident_bytes(0),
+        index_bytes(0), over_limit(false) {};
 
-    Database() : id_counter(0) {};
+    ~Database() {
+        // Releases the formulas of the stored states from the pool
+        for (auto& item : data)
+            item.sym_container.clear();
+    }
+
+    /**
+     * Limits memory used by resident symbolic containers to given number of
+     * bytes, 0 means no limit. Has to be set before the first insertion.
+     */
+    void set_mem_limit(size_t bytes) {
+        assert(data.empty());
+        mem_limit = bytes;
+    }
 
-    bool seen(const ExplState &st) {
-        auto got = state2item_table.find(st);
+    bool seen(const ExplState &st, const Chunks& chunks) {
+        Compressed key;
+        if (!compress(st, chunks, key, false))
+            return false;
+        auto got = state2item_table.find(key);
         if (got == state2item_table.end())
             return false;
         else {
             SymbState sst;
             fillSym(sst, st);
+            touch(got->second);
             return data[got->second].sym_container.seen(sst);
         }
     }
@@ -213,51 +217,21 @@ public:
     }
 
     //assume st is not yet stored
-    StateId insert(const ExplState &st) {
-        auto got = state2item_table.find(st);
-        if (got == state2item_table.end()) {
-            // Create new explicit item
-            data.push_back(ExplicitItem());
-            ExplicitItem& item = data.back();
-            item.explicit_id = ++id_counter;
-            item.exp_state = st;
-            size_t item_idx = data.size() - 1;
-            
-            // Prepare symbolic data
-            SymbState sst;
-            fillSym(sst, st);
-            
-            // Fill correct id
-            StateId id;
-            id.sym_id = item.sym_container.insert(sst);
-            id.exp_id = item.explicit_id;
-            
-            // Insert correct items in tables
-            state2item_table.insert(std::make_pair(st, item_idx));
-            id2item_table.insert(std::make_pair(id, item_idx));
-            
-            return id;
-        }
-        else {
-            ExplicitItem& item = data[got->second];
-            
-            SymbState sst;
-            fillSym(sst, st);
-            StateId id;
-            id.exp_id = item.explicit_id;
-            id.sym_id = item.sym_container.insert(sst);
-            
-            id2item_table.insert(std::make_pair(id, got->second));
-            return id;
-        }
+    StateId insert(const ExplState &st, const Chunks& chunks) {
+        Compressed key;
+        compress(st, chunks, key, true);
+        return insert(st, key);
     }
 
-    std::pair<bool, StateId> insertCheck(const ExplState &st) {
-        auto got = state2item_table.find(st);
+    std::pair<bool, StateId> insertCheck(const ExplState &st, const Chunks& chunks) {
+        Compressed key;
+        compress(st, chunks, key, true);
+        auto got = state2item_table.find(key);
         if (got == state2item_table.end()) {
-            return std::make_pair(true, insert(st));
+            return std::make_pair(true, insert(st, key));
         }
         else {
+            touch(got->second);
             ExplicitItem& item = data[got->second];
             
             SymbState sst;
@@ -269,7 +243,7 @@ public:
             id.sym_id = ret.second;
             
             if (ret.first)
-                id2item_table.insert(std::make_pair(id, got->second));
+                stored(id, got->second);
             return std::make_pair(ret.first, id);
         }
     }
@@ -277,14 +251,35 @@ public:
     void fillSym(SymbState &sst, const ExplState &st) {
         const char * temp = st.getSymb();
         sst.readData(temp);
+        // Equivalent states differing only in generations have to match
+        sst.renumber_generations();
     }
 
     size_t size() {
-        size_t retVal = 0;
-        for (auto e : state2item_table) {
-            retVal += data[e.second].sym_container.size();
-        }
-        return retVal;
+        return state_count;
+    }
+
+    /**
+     * Returns index of the state in the order of discovery, states are
+     * numbered densely from 0
+     */
+    uint32_t index_of(StateId id) const {
+        auto res = id2item_table.find(id);
+        if (res == id2item_table.end())
+            throw DatabaseException("Cannot find state <"
+                    + std::to_string(id.exp_id) + ", "
+                    + std::to_string(id.sym_id) + ">");
+        return res->second.index;
+    }
+
+    /**
+     * Returns ids of all states in the order of discovery
+     */
+    std::vector<StateId> ids() const {
+        std::vector<StateId> result(state_count);
+        for (const auto& id : id2item_table)
+            result[id.second.index] = id.first;
+        return result;
     }
 
     ExplState getState(StateId id) {
@@ -292,41 +287,349 @@ public:
         if (res == id2item_table.end()) {
             std::cout << "Table content: ";
             for(const auto& item : id2item_table)
-                std::cout << item.first << " -> " << item.second;
+                std::cout << item.first << " -> " << item.second.item;
             std::cout << "\n";
             throw DatabaseException("Cannot find state <"
                     + std::to_string(id.exp_id) + ", "
                     + std::to_string(id.sym_id) + ">");
         }
         
-        const auto& expl_state = data[res->second].exp_state;
-        const auto& sym_state = data[res->second].sym_container.get(id.sym_id);
-        ExplState b(expl_state.getExplSize() + expl_state.getUserSize() + sym_state.getSize(),
-            expl_state.getExplSize(),
-            expl_state.getUserSize());
-
-        expl_state.writeUser(b.getUser());
-        expl_state.writeExpl(b.getExpl());
-        char* sym = b.getSymb();
-        sym_state.writeData(sym); 
+        touch(res->second.item);
+        const ExplicitItem& item = data[res->second.item];
+        const auto& sym_state = item.sym_container.get(id.sym_id);
+        ExplState b(item.user_size + item.explicit_size + sym_state.getSize(),
+            item.explicit_size, item.user_size);
+
+        char* mem = b.getUser();
+        for (ChunkPool::Ref r : *item.exp_state) {
+            const std::string& chunk = chunks.get(r);
+            memcpy(mem, chunk.data(), chunk.size());
+            mem += chunk.size();
+        }
+        assert(mem == b.getSymb());
+        sym_state.writeData(mem);
     
         return b;
     }
 
+    /**
+     * Dumps statistic info about the compression to given stream
+     */
+    void dump_stat(std::ostream& s) const {
+        size_t uncompressed = 0;
+        for (const auto& item : data)
+            uncompressed += item.user_size + item.explicit_size;
+        size_t compressed = chunks.bytes();
+        for (const auto& item : data)
+            compressed += item.exp_state->size() * sizeof(ChunkPool::Ref);
+        s << "Explicit states: " << data.size() << "\n";
+        s << "Unique chunks:   " << chunks.size() << "\n";
+        s << "Explicit bytes:  " << uncompressed << " (" << compressed
+          << " compressed)\n";
+        if (mem_limit != 0)
+            s << "Spilled bytes:   " << disk.size() << "\n";
+    }
+
+    /**
+     * Serializes the whole database, used for checkpointing
+     */
+    template <class Writer>
+    void save(Writer& w) {
+        chunks.save(w);
+        w.write(data.size());
+        for (const auto& item : data) {
+            w.write(item.explicit_id);
+            w.write(*item.exp_state);
+            w.write(item.user_size);
+            w.write(item.explicit_size);
+            if (item.spilled)
+                w.write(disk.read(item.record));
+            else {
+                std::string buffer(item.sym_container.getSize(), '\0');
+                char* mem = &buffer[0];
+                item.sym_container.writeData(mem);
+                w.write(buffer);
+            }
+        }
+        w.write(std::vector<std::pair<StateId, Location>>(
+            id2item_table.begin(), id2item_table.end()));
+        w.write(id_counter);
+        w.write(state_count);
+    }
+
+    /**
+     * Restores database saved by save, the database has to be empty
+     */
+    template <class Reader>
+    void load(Reader& r) {
+        assert(data.empty());
+        chunks.load(r);
+        size_t size;
+        r.read(size);
+        data.reserve(size);
+        for (size_t i = 0; i != size; i++) {
+            data.push_back(ExplicitItem());
+            ExplicitItem& item = data.back();
+            r.read(item.explicit_id);
+            Compressed key;
+            r.read(key);
+            item.exp_state = &state2item_table.insert(std::make_pair(key, i)).first->first;
+            r.read(item.user_size);
+            r.read(item.explicit_size);
+
+            std::string buffer;
+            r.read(buffer);
+            const char* mem = buffer.data();
+            item.sym_container.readData(mem);
+            index_bytes += item_bytes(key);
+            if (mem_limit != 0) {
+                item.resident = item.sym_container.memory();
+                resident_bytes += item.resident;
+                lru.push_front(i);
+                item.lru_pos = lru.begin();
+                evict();
+            }
+        }
+        std::vector<std::pair<StateId, Location>> ids;
+        r.read(ids);
+        id2item_table.insert(ids.begin(), ids.end());
+        index_bytes += ids.size() * id_bytes();
+        r.read(id_counter);
+        r.read(state_count);
+    }
+
 private:
+    typedef std::vector<ChunkPool::Ref> Compressed;
+
+    struct CompressedHash {
+        size_t operator()(const Compressed& c) const {
+            hash128_t h = spookyHash(c.data(), c.size() * sizeof(ChunkPool::Ref), 0, 0);
+            return h.first ^ h.second;
+        }
+    };
+
+    /**
+     * Position of a state: its explicit item and its index in the order of
+     * discovery
+     */
+    struct Location {
+        uint32_t item;
+        uint32_t index;
+    };
+
     struct ExplicitItem {
         IdType explicit_id;
-        ExplState exp_state;
+        const Compressed* exp_state; // Points to the key in state2item_table
+        size_t user_size;
+        size_t explicit_size;
         SymbContainer sym_container;
+
+        size_t resident;    // Memory charged for sym_container
+        bool spilled;       // sym_container is on disk only
+        bool dirty;         // sym_container has no valid copy on disk
+        DiskStore::Record record;
+        std::list<size_t>::iterator lru_pos;
+
+        ExplicitItem() : resident(0), spilled(false), dirty(true) {}
     };
-    
+
+    /**
+     * Splits the user and explicit part of st into chunks and fills their
+     * references into key. If insert is false, returns false when some of
+     * the chunks is not in the pool (i.e. the state has not been seen).
+     */
+    bool compress(const ExplState& st, const Chunks& sizes, Compressed& key,
+        bool insert)
+    {
+        key.clear();
+        key.reserve(sizes.size() + 1);
+        const char* mem = st.getExpl();
+        if (st.getUserSize() != 0
+            && !add_chunk(st.getUser(), st.getUserSize(), key, insert))
+            return false;
+        for (size_t size : sizes) {
+            if (!add_chunk(mem, size, key, insert))
+                return false;
+            mem += size;
+        }
+        assert(mem == st.getSymb());
+        return true;
+    }
+
+    bool add_chunk(const char* mem, size_t size, Compressed& key, bool insert) {
+        ChunkPool::Ref r;
+        if (insert)
+            r = chunks.intern(mem, size);
+        else if (!chunks.find(mem, size, r))
+            return false;
+        key.push_back(r);
+        return true;
+    }
+
+    StateId insert(const ExplState& st, const Compressed& key) {
+        auto got = state2item_table.find(key);
+        if (got == state2item_table.end()) {
+            // Create new explicit item
+            size_t item_idx = data.size();
+            got = state2item_table.insert(std::make_pair(key, item_idx)).first;
+
+            data.push_back(ExplicitItem());
+            ExplicitItem& item = data.back();
+            item.explicit_id = ++id_counter;
+            item.exp_state = &got->first;
+            item.user_size = st.getUserSize();
+            item.explicit_size = st.getExplSize();
+            index_bytes += item_bytes(key);
+            if (mem_limit != 0) {
+                lru.push_front(item_idx);
+                item.lru_pos = lru.begin();
+            }
+        }
+        else
+            touch(got->second);
+        ExplicitItem& item = data[got->second];
+
+        // Prepare symbolic data
+        SymbState sst;
+        fillSym(sst, st);
+
+        // Fill correct id
+        StateId id;
+        id.exp_id = item.explicit_id;
+        id.sym_id = item.sym_container.insert(sst);
+
+        stored(id, got->second);
+        return id;
+    }
+
+    /**
+     * Approximate memory used by the index of an explicit item and of a state
+     */
+    static size_t item_bytes(const Compressed& key) {
+        return sizeof(ExplicitItem) + sizeof(std::pair<Compressed, size_t>)
+            + key.size() * sizeof(ChunkPool::Ref) + 2 * sizeof(void*);
+    }
+
+    static size_t id_bytes() {
+        return sizeof(std::pair<StateId, Location>) + 2 * sizeof(void*);
+    }
+
+    /**
+     * Memory charged against the limit
+     */
+    size_t used_bytes() const {
+        return resident_bytes + index_bytes + chunks.bytes() + Formulas.bytes();
+    }
+
+    /**
+     * Registers a new symbolic state stored in given item and accounts for it
+     */
+    void stored(StateId id, size_t item_idx) {
+        Location loc = { uint32_t(item_idx), uint32_t(state_count) };
+        id2item_table.insert(std::make_pair(id, loc));
+        IdType sym_id = id.sym_id;
+        state_count++;
+        index_bytes += id_bytes();
+        ExplicitItem& item = data[item_idx];
+        if (!item.dirty) {
+            // The copy on disk is outdated now
+            disk.discard(item.record);
+            item.dirty = true;
+        }
+        if (mem_limit == 0)
+            return;
+        size_t bytes = item.sym_container.memory(sym_id);
+        item.resident += bytes;
+        resident_bytes += bytes;
+        evict();
+    }
+
+    /**
+     * Marks item as the most recently used, loads it from disk if needed
+     */
+    void touch(size_t item_idx) {
+        if (mem_limit == 0)
+            return;
+        ExplicitItem& item = data[item_idx];
+        if (!item.spilled) {
+            lru.splice(lru.begin(), lru, item.lru_pos);
+            return;
+        }
+
+        std::string buffer = disk.read(item.record);
+        const char* mem = buffer.data();
+        item.sym_container.readData(mem);
+        item.spilled = false;
+        item.dirty = false;
+        item.resident = item.sym_container.memory();
+        resident_bytes += item.resident;
+        lru.push_front(item_idx);
+        item.lru_pos = lru.begin();
+        evict();
+    }
+
+    /**
+     * Spills the least recently used items until the limit is met, the most
+     * recently used item always stays in memory
+     */
+    void evict() {
+        while (mem_limit != 0 && used_bytes() > mem_limit && lru.size() > 1) {
+            size_t item_idx = lru.back();
+            lru.pop_back();
+            ExplicitItem& item = data[item_idx];
+            if (item.dirty) {
+                std::string buffer(item.sym_container.getSize(), '\0');
+                char* mem = &buffer[0];
+                item.sym_container.writeData(mem);
+                item.record = disk.append(buffer);
+                item.dirty = false;
+            }
+            // Releases the formulas of the item from the pool
+            item.sym_container.clear();
+            item.spilled = true;
+            resident_bytes -= item.resident;
+            item.resident = 0;
+        }
+        if (mem_limit != 0 && !over_limit && used_bytes() > mem_limit
+            && lru.size() <= 1)
+        {
+            over_limit = true;
+            std::cerr << "Warning: explicit parts and formulas of states exceed "
+                      << "the memory limit, they cannot be spilled to disk\n";
+        }
+        compact();
+    }
+
+    /**
+     * Rewrites the spill file without the outdated records once they take
+     * more than half of it
+     */
+    void compact() {
+        if (disk.garbage() * 2 <= disk.size())
+            return;
+        DiskStore fresh;
+        for (auto& item : data) {
+            if (!item.dirty)
+                item.record = fresh.append(disk.read(item.record));
+        }
+        disk.swap(fresh);
+    }
+
+    ChunkPool chunks;
     std::vector<ExplicitItem> data;
     
-    std::unordered_map<
-        ExplState, size_t, ExplHasher, ExplEqual> state2item_table;
-    std::unordered_map<StateId, size_t> id2item_table;
+    std::unordered_map<Compressed, size_t, CompressedHash> state2item_table;
+    std::unordered_map<StateId, Location> id2item_table;
 
     IdType id_counter; // Holds next free id
+    size_t state_count;
+
+    size_t mem_limit;
+    size_t resident_bytes; // Memory of the resident symbolic containers
+    size_t index_bytes;    // Memory of the explicit items and the tables
+    bool over_limit;       // The limit cannot be met by spilling
+    std::list<size_t> lru; // Resident items, the most recently used first
+    DiskStore disk;
 };
 
 struct EmptyValue {
@@ -361,22 +664,29 @@ struct SMTEqual {
 
 template <class Store>
 struct SMTSubseteq {
-    bool operator()(const Store &a, const Store &b) const {
+    // b is either a Store or its packed form (Store::Packed)
+    template <class Stored>
+    bool operator()(const Store &a, const Stored &b) const {
         //assert( a.segments_mapping.size() == b.segments_mapping.size() );
         static bool timeout = !Config.is_set("--disabletimeout");
         static bool cache = Config.is_set("--enablecaching");
-        return a.subseteq(a, b, timeout, cache);
+        return Store::subseteq(a, b, timeout, cache);
     }
 };
 
-template< typename State, typename Hit >
+/**
+ * Stores symbolic parts in their packed form (State::Packed). A new candidate
+ * is compared with the packed states directly (see SMTStore::Packed), they are
+ * unpacked only by seen.
+ */
+template< typename State, typename Hit, typename Stored = typename State::Packed >
 class LinearCandidate {
 public:
     typedef typename StateId::IdType IdType;
 
     bool seen(const State &st) {
-        for (auto e : data) {
-            if (hit(e, st))
+        for (const auto& e : data) {
+            if (hit(view(e), st))
                 return true;
         }
         return false;
@@ -387,18 +697,18 @@ public:
     }
 
     IdType insert(const State &st) {
-        data.push_back(st);
+        data.emplace_back(st);
         return data.size();
     }
 
     std::pair<bool, IdType> insertCheck(const State &st) {
         IdType id = 1;
-        for (auto e : data) {
+        for (const auto& e : data) {
             if (hit(st, e))
                 return std::make_pair(false, id);
             id++;
         }
-        data.push_back(st);
+        data.emplace_back(st);
         return std::make_pair(true, data.size());
     }
 
@@ -406,11 +716,78 @@ public:
         return data.size();
     }
     
-    const State& get(IdType id) {
+    /**
+     * The stored form of the state, it serializes the same as State
+     */
+    const Stored& get(IdType id) const {
         return data[id - 1];
     }
+
+    /**
+     * Serialization of the whole container, used for spilling it to disk
+     */
+    size_t getSize() const {
+        size_t size = sizeof(size_t);
+        for (const auto& e : data)
+            size += e.getSize();
+        return size;
+    }
+
+    void writeData(char * &mem) const {
+        blobWrite(mem, data.size());
+        for (const auto& e : data)
+            e.writeData(mem);
+    }
+
+    void readData(const char * &mem) {
+        size_t count;
+        blobRead(mem, count);
+        clear();
+        data.reserve(count);
+        for (size_t i = 0; i != count; i++) {
+            State st;
+            st.readData(mem);
+            data.emplace_back(st);
+        }
+    }
+
+    void clear() {
+        std::vector<Stored>().swap(data);
+    }
+
+    /**
+     * Approximate memory used by the container or by one of its states
+     */
+    size_t memory() const {
+        size_t size = sizeof(*this) + (data.capacity() - data.size()) * sizeof(Stored);
+        for (const auto& e : data)
+            size += memory(e);
+        return size;
+    }
+
+    size_t memory(IdType id) const {
+        return memory(data[id - 1]);
+    }
 private:
-    std::vector<State> data;
+    static const State& view(const State& s) {
+        return s;
+    }
+
+    template <class P>
+    static State view(const P& p) {
+        return State(p);
+    }
+
+    static size_t memory(const State& s) {
+        return sizeof(State) + s.getSize();
+    }
+
+    template <class P>
+    static size_t memory(const P& p) {
+        return p.memory();
+    }
+
+    std::vector<Stored> data;
     Hit hit;
 };
 
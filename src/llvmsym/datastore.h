@@ -104,6 +104,12 @@ struct DataStore {
 
     virtual void eraseSegment( int id ) = 0;
 
+    // renumbers segments, map[ old_id ] is the new id or -1 for dropped ones
+    virtual void remapSegments( const std::vector< int > &map ) = 0;
+
+    // drops erased segments with id >= count
+    virtual void truncateSegments( unsigned count ) = 0;
+
   //   virtual static bool equal( char *mem_a, char *mem_b ) = 0;
   
   virtual void clear() = 0;
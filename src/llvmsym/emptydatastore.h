@@ -264,6 +264,10 @@ struct EmptyStore : public DataStore {
     std::cout << "Removed segment: " << id << std::endl;
   }
 
+  virtual void truncateSegments( unsigned count ) {}
+
+  virtual void remapSegments( const std::vector< int > &map ) {}
+
   friend std::ostream & operator<<( std::ostream & o, const EmptyStore &v );
   
   virtual void clear() {}
@@ -234,17 +234,14 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
         state.control.leave( tid );
         
         // drop stack
-        std::pair< int, int > segments_range = state.layout.getLastStackSegmentRange( tid );
-
-        for ( int s = segments_range.first; s < segments_range.second; ++s ) {
-            state.data.eraseSegment( segments_range.first );
-            state.explicitData.eraseSegment( segments_range.first );
-            state.layout.eraseSegment( segments_range.first );
+        for ( int s : state.layout.getLastStackSegments( tid ) ) {
+            state.data.eraseSegment( s );
+            state.explicitData.eraseSegment( s );
+            state.layout.eraseSegment( s );
         }
-        state.explicitData.movePointers(
-                segments_range.first,
-                -( segments_range.second - segments_range.first ) );
         state.layout.leave( tid );
+        state.data.truncateSegments( state.layout.getSegmentCount() );
+        state.explicitData.truncateSegments( state.layout.getSegmentCount() );
 
         // if not returning from last function, set block stack memory layout
         if ( !last ) {
@@ -257,8 +254,7 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
     {
         state.control.enterFunction( fun_id, tid );
         state.layout.newStack( tid );
-        state.layout.newSegment( tid );
-        int sid = state.layout.getLastStackSegmentRange( tid ).first;
+        int sid = state.layout.newSegment( tid );
 
         const std::vector< int > &bitwidths = getBitWidthList( fun_id );
 
@@ -266,7 +262,6 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
         state.explicitData.addSegment( sid, bitwidths );
         state.layout.addSegment( sid, bitwidths );
 
-        state.explicitData.movePointers( sid, 1 );
         state.layout.switchBB( getBB( state.control.getPC( tid ) ), tid );
     }
 
@@ -379,10 +374,27 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
                 return;
             }
             else if (isFunctionInput(fun_name)) {
+                static long concretize_below = Config.get_long("--concretize-below");
                 Value to = deref(ci, tid, false);
-                state.layout.setMultival(to, true);
-                state.data.implement_input(to, getBitWidth(ci->getType()));
-                yield(false, false, true);
+                int bw = getBitWidth(ci->getType());
+                if (bw < 64 && concretize_below > 0
+                    && (uint64_t(1) << bw) <= uint64_t(concretize_below))
+                {
+                    // Small domain - enumerate all values as explicit successors
+                    uint64_t count = uint64_t(1) << bw;
+                    for (uint64_t val = 0; val != count; ++val) {
+                        if (val != 0)
+                            state.control.advance(tid);
+                        state.layout.setMultival(to, false);
+                        state.explicitData.implement_store(to, Value(val, bw));
+                        yield(false, false, val + 1 == count);
+                    }
+                }
+                else {
+                    state.layout.setMultival(to, true);
+                    state.data.implement_input(to, bw);
+                    yield(false, false, true);
+                }
             }
             else if (isFunctionAssume(fun_name)) {
                 llvm::Value *llvm_cond = ci->getArgOperand(0);
@@ -524,8 +536,6 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
         state.explicitData.addSegment( sid, bws );
         state.layout.addSegment( sid, bws );
 
-        state.explicitData.movePointers( sid, 1 );
-
         state.layout.setMultival( deref( alloca_inst, tid, false ), false );
         state.explicitData.implement_pointer_store( deref( alloca_inst, tid, false ), ptr );
         yield( false, false, true );
@@ -899,6 +909,22 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
         store->implement_inttoptr(res, a);
     }
 
+    /**
+     * Segments are allocated in their canonical slots, which depend on the
+     * number of threads. When a thread start or finish has moved them,
+     * renumber them before the state is observed, so equal states have equal
+     * explicit representation.
+     */
+    void canonizeSegments()
+    {
+        std::vector< int > map = state.layout.canonicalSegments();
+        if ( map.empty() )
+            return;
+        state.layout.remapSegments( map );
+        state.explicitData.remapSegments( map );
+        state.data.remapSegments( map );
+    }
+
     BB actualBB( int tid ) const
     {
         const PC &pc = state.control.getPC( tid );
@@ -941,6 +967,54 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
             + state.explicitData.getSize() + state.properties.getSize();
     }
 
+    /**
+     * Returns sizes of the chunks the explicit part of the written state
+     * consists of (properties with control, layout, explicit segments)
+     */
+    std::vector< size_t > getExplicitChunks() const
+    {
+        std::vector< size_t > chunks;
+        chunks.push_back( state.properties.getSize() + state.control.getSize() );
+        chunks.push_back( state.layout.getSize() );
+        state.explicitData.getChunkSizes( chunks );
+        return chunks;
+    }
+
+    /**
+     * Returns source line of the current instruction of given thread from
+     * the debug info, 0 if it is not available
+     */
+    unsigned getSourceLine( int tid ) const
+    {
+        return fetch( tid )->getDebugLoc().getLine();
+    }
+
+    /**
+     * Decides proposition guard in the current state without the data store
+     * if all of its variables are explicit
+     * @return UNKNOWN if the guard depends on a symbolic variable
+     */
+    TriState decideGuard( const Formula &guard ) const
+    {
+        uint64_t result;
+        bool decided = guard.evaluate( result,
+            [&]( const Formula::Ident &id, uint64_t &value, int &bw ) {
+                Value var;
+                var.type = Value::Type::Variable;
+                var.variable.segmentId = id.seg;
+                var.variable.offset = id.off;
+                if ( state.layout.isMultival( var ) )
+                    return false;
+                value = state.explicitData.get( var );
+                bw = state.explicitData.getBw( var );
+                return true;
+            } );
+
+        if ( !decided )
+            return TriState::UNKNOWN;
+        return result ? TriState::TRUE : TriState::FALSE;
+    }
+
 	Evaluator(std::shared_ptr< BitCode > b) :
 		main(nullptr), state(b.get()->module.get()), bc(b)
     {
@@ -1062,7 +1136,7 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
         auto last_pc = state.control.getPC(last_thread);
         BB bb = getBB(last_pc);
         state.layout.startThread();
-        unsigned sid = state.layout.getLastStackSegmentRange( last_thread ).first;
+        unsigned sid = state.layout.getFrameSegment( last_thread );
 
         std::vector< int > bitwidths = getBitWidthList( fun_id );
 
@@ -1070,8 +1144,6 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
         state.explicitData.addSegment( sid, bitwidths );
         state.layout.addSegment( sid, bitwidths );
 
-        state.explicitData.movePointers( sid, 1 );
-
         state.layout.switchBB( bb, last_thread );
 
         return tid;
@@ -1110,6 +1182,7 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
 
     void advance( const std::function<void ()> yield )
     {
+        static bool collect_garbage = !Config.is_set("--disablegc");
         auto allowed = state.control.get_allowed_threads();
 	    for (size_t tid : allowed) {
             std::stack<State> to_do;
@@ -1138,6 +1211,10 @@ class Evaluator : Dispatcher< Evaluator< DataStore > >{
                     }
                     if (!is_empty) {
 	                    if (is_observable || is_error()) {
+                            canonizeSegments();
+                            // Sound only for non-empty states
+                            if (collect_garbage)
+                                state.data.collect_garbage();
                             yield();
                         } else {
                             to_do.push(std::move(state));
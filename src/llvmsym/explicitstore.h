@@ -42,6 +42,15 @@ class ValueStore : public DataStore {
         _info[ a.variable.segmentId ][ a.variable.offset ].is_pointer = flag;
     }
 
+    static uint64_t lower_to_nbits( uint64_t what, int bw ) {
+        if ( bw == 64 )
+            return what;
+        uint64_t mask = (1llu << bw) - 1;
+        return what & mask;
+    }
+
+    public:
+
     int getBw( Value a ) const {
         if ( a.type == Value::Type::Constant )
             return a.constant.bw;
@@ -51,15 +60,6 @@ class ValueStore : public DataStore {
         return _info[ a.variable.segmentId ][ a.variable.offset ].bw;
     }
 
-    static uint64_t lower_to_nbits( uint64_t what, int bw ) {
-        if ( bw == 64 )
-            return what;
-        uint64_t mask = (1llu << bw) - 1;
-        return what & mask;
-    }
-
-    public:
-    
     struct Pointer {
         typename DataStore::VariableId content;
 
@@ -111,6 +111,20 @@ class ValueStore : public DataStore {
         blobWrite( mem, _data, _info, _empty );
     }
 
+    /**
+     * Appends sizes of the chunks of the serialized store - one chunk per
+     * segment of data followed by a single chunk with the variable info
+     */
+    void getChunkSizes( std::vector< size_t > &chunks ) const
+    {
+        size_t header = representation_size( _data.size() );
+        for ( const auto &segment : _data ) {
+            chunks.push_back( header + representation_size( segment ) );
+            header = 0;
+        }
+        chunks.push_back( header + representation_size( _info, _empty ) );
+    }
+
     virtual void readData( const char * &mem )
     {
         _data.clear();
@@ -119,9 +133,13 @@ class ValueStore : public DataStore {
 
     virtual void addSegment( unsigned id, const std::vector< int > &bit_widths )
     {
-        assert( id <= _data.size() );
-        _data.emplace( _data.begin() + id, bit_widths.size(), Element() );
-        std::vector< VariableInfo >& infos = *_info.insert( _info.begin() + id, std::vector< VariableInfo >() );
+        if ( id >= _data.size() ) {
+            _data.resize( id + 1 );
+            _info.resize( id + 1 );
+        }
+        _data[ id ].assign( bit_widths.size(), Element() );
+        std::vector< VariableInfo >& infos = _info[ id ];
+        infos.clear();
         for ( int bw : bit_widths ) {
             infos.push_back( VariableInfo( { static_cast< char >( bw ), false } ) );
         }
@@ -129,12 +147,54 @@ class ValueStore : public DataStore {
 
     virtual void eraseSegment( int id )
     {
-        _data.erase( _data.begin() + id );
-        _info.erase( _info.begin() + id );
+        _data[ id ].clear();
+        _info[ id ].clear();
     }
 
-    void movePointers( unsigned from, int move_count )
+    virtual void truncateSegments( unsigned count )
     {
+        if ( count < _data.size() ) {
+            _data.resize( count );
+            _info.resize( count );
+        }
+    }
+
+    virtual void remapSegments( const std::vector< int > &map )
+    {
+        assert( map.size() == _data.size() );
+
+        int count = 0;
+        bool moved = false;
+        for ( size_t seg = 0; seg < map.size(); ++seg ) {
+            count = std::max( count, map[ seg ] + 1 );
+            moved = moved || ( map[ seg ] != -1 && map[ seg ] != int( seg ) );
+        }
+
+        if ( !moved ) {
+            // Only dropped segments, no pointer refers to them
+            _data.resize( count );
+            _info.resize( count );
+            for ( size_t seg = 0; seg < size_t( count ); ++seg ) {
+                if ( map[ seg ] == -1 ) {
+                    _data[ seg ].clear();
+                    _info[ seg ].clear();
+                }
+            }
+            return;
+        }
+
+        Data data( count );
+        std::vector< std::vector< VariableInfo > > info( count );
+        for ( size_t seg = 0; seg < map.size(); ++seg ) {
+            if ( map[ seg ] == -1 )
+                continue;
+            data[ map[ seg ] ] = std::move( _data[ seg ] );
+            info[ map[ seg ] ] = std::move( _info[ seg ] );
+        }
+        _data = std::move( data );
+        _info = std::move( info );
+
+        // pointers are the only values which refer to segment ids
         for ( unsigned seg = 0; seg < _data.size(); ++seg ) {
             for ( unsigned offset = 0; offset < _data[seg].size(); ++offset ) {
                 if ( !_info[ seg ][ offset ].is_pointer )
@@ -142,11 +202,10 @@ class ValueStore : public DataStore {
 
                 Pointer ptr = Pointer( _data[ seg ][ offset ] );
 
-                if ( ptr.content.segmentId > from ) {
-                    ptr.content.segmentId += move_count;
+                if ( ptr.content.segmentId < map.size() && map[ ptr.content.segmentId ] != -1 ) {
+                    ptr.content.segmentId = map[ ptr.content.segmentId ];
                     _data[ seg ][ offset ] = static_cast< uint64_t >( ptr );
                 }
-
             }
         }
     }
@@ -0,0 +1,505 @@
+#include <llvmsym/formula/abstract.h>
+
+#include <algorithm>
+
+namespace llvm_sym {
+
+namespace {
+    typedef Formula::Item Item;
+    typedef std::vector< Item >::const_iterator It;
+
+    /**
+     * Returns the beginning of the subformula ending just before end
+     */
+    It subformula( It begin, It end )
+    {
+        int needed = 1;
+        It i = end;
+        while ( needed > 0 ) {
+            assert( i != begin );
+            --i;
+            --needed;
+            if ( i->kind == Item::Op )
+                needed += i->is_unary_op() ? 1 : 2;
+        }
+        return i;
+    }
+
+    const Formula::Ident &symbol_of( const Definition &d ) { return d.symbol; }
+    const Formula &definition_of( const Definition &d ) { return d.def; }
+    const Formula &formula_of( const Formula &f ) { return f; }
+
+    const Formula::Ident &symbol_of( const AbstractEnv::DefinitionRef &d ) { return d.first; }
+    const Formula &definition_of( const AbstractEnv::DefinitionRef &d ) { return *d.second; }
+    const Formula &formula_of( const Formula *f ) { return *f; }
+
+    bool is_comparison( Item::Operator op )
+    {
+        switch ( op ) {
+            case Item::Eq: case Item::NEq:
+            case Item::LT: case Item::LEq: case Item::GT: case Item::GEq:
+            case Item::ULT: case Item::ULEq: case Item::UGT: case Item::UGEq:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    Item::Operator negate( Item::Operator op )
+    {
+        switch ( op ) {
+            case Item::Eq:   return Item::NEq;
+            case Item::NEq:  return Item::Eq;
+            case Item::LT:   return Item::GEq;
+            case Item::LEq:  return Item::GT;
+            case Item::GT:   return Item::LEq;
+            case Item::GEq:  return Item::LT;
+            case Item::ULT:  return Item::UGEq;
+            case Item::ULEq: return Item::UGT;
+            case Item::UGT:  return Item::ULEq;
+            case Item::UGEq: return Item::ULT;
+            default:
+                abort();
+        }
+    }
+
+    /**
+     * Comparison with swapped operands, a op b iff b swap(op) a
+     */
+    Item::Operator swap( Item::Operator op )
+    {
+        switch ( op ) {
+            case Item::LT:   return Item::GT;
+            case Item::LEq:  return Item::GEq;
+            case Item::GT:   return Item::LT;
+            case Item::GEq:  return Item::LEq;
+            case Item::ULT:  return Item::UGT;
+            case Item::ULEq: return Item::UGEq;
+            case Item::UGT:  return Item::ULT;
+            case Item::UGEq: return Item::ULEq;
+            default:
+                return op;
+        }
+    }
+
+    bool is_signed( Item::Operator op )
+    {
+        return op == Item::LT || op == Item::LEq || op == Item::GT || op == Item::GEq;
+    }
+
+    Item::Operator to_unsigned( Item::Operator op )
+    {
+        switch ( op ) {
+            case Item::LT:   return Item::ULT;
+            case Item::LEq:  return Item::ULEq;
+            case Item::GT:   return Item::UGT;
+            case Item::GEq:  return Item::UGEq;
+            default:
+                return op;
+        }
+    }
+
+    uint64_t sign_bit( const AbstractValue &v )
+    {
+        return uint64_t( 1 ) << ( v.bw - 1 );
+    }
+
+    AbstractValue make( int bw, uint64_t lo, uint64_t hi, uint64_t zeros = 0, uint64_t ones = 0 )
+    {
+        AbstractValue v = AbstractValue::top( bw );
+        if ( v.wide() )
+            return v;
+        v.zeros |= zeros;
+        v.ones = ones & v.mask();
+        v.lo = std::max( lo, v.ones );
+        v.hi = std::min( hi & v.mask(), ~v.zeros & v.mask() );
+        return v;
+    }
+
+    /**
+     * Maps signed order to unsigned one by flipping the sign bit, intervals
+     * crossing the sign boundary become top
+     */
+    AbstractValue biased( const AbstractValue &v )
+    {
+        uint64_t sb = sign_bit( v );
+        if ( ( v.lo & sb ) != ( v.hi & sb ) )
+            return AbstractValue::top( v.bw );
+        return make( v.bw, v.lo ^ sb, v.hi ^ sb );
+    }
+
+    AbstractValue unknown_bool()
+    {
+        return AbstractValue::top( 0 );
+    }
+
+    AbstractValue compare( Item::Operator op, AbstractValue l, AbstractValue r )
+    {
+        if ( l.wide() || r.wide() || l.is_bottom() || r.is_bottom() )
+            return unknown_bool();
+        if ( is_signed( op ) ) {
+            l = biased( l );
+            r = biased( r );
+            op = to_unsigned( op );
+        }
+        switch ( op ) {
+            case Item::Eq:
+                if ( l.lo == l.hi && r.lo == r.hi && l.lo == r.lo )
+                    return AbstractValue::boolean( true );
+                if ( l.disjoint( r ) )
+                    return AbstractValue::boolean( false );
+                return unknown_bool();
+            case Item::NEq: {
+                AbstractValue eq = compare( Item::Eq, l, r );
+                return make( 0, 1 - eq.hi, 1 - eq.lo );
+            }
+            case Item::UGT:
+            case Item::UGEq:
+                return compare( swap( op ), r, l );
+            case Item::ULT:
+                if ( l.hi < r.lo )
+                    return AbstractValue::boolean( true );
+                if ( l.lo >= r.hi )
+                    return AbstractValue::boolean( false );
+                return unknown_bool();
+            case Item::ULEq:
+                if ( l.hi <= r.lo )
+                    return AbstractValue::boolean( true );
+                if ( l.lo > r.hi )
+                    return AbstractValue::boolean( false );
+                return unknown_bool();
+            default:
+                abort();
+        }
+    }
+
+    /**
+     * Values of x satisfying x op v in the unsigned order
+     */
+    AbstractValue restrict_by( Item::Operator op, const AbstractValue &x, const AbstractValue &v )
+    {
+        AbstractValue res = x;
+        switch ( op ) {
+            case Item::Eq:
+                return x.meet( v );
+            case Item::NEq:
+                if ( v.lo != v.hi )
+                    return res;
+                if ( res.lo == v.lo && res.hi == v.lo )
+                    res.lo = 1, res.hi = 0;
+                else if ( res.lo == v.lo )
+                    ++res.lo;
+                else if ( res.hi == v.lo )
+                    --res.hi;
+                return res;
+            case Item::ULT:
+                if ( v.hi == 0 )
+                    res.lo = 1, res.hi = 0;
+                else
+                    res.hi = std::min( res.hi, v.hi - 1 );
+                return res;
+            case Item::ULEq:
+                res.hi = std::min( res.hi, v.hi );
+                return res;
+            case Item::UGT:
+                if ( v.lo == res.mask() )
+                    res.lo = 1, res.hi = 0;
+                else
+                    res.lo = std::max( res.lo, v.lo + 1 );
+                return res;
+            case Item::UGEq:
+                res.lo = std::max( res.lo, v.lo );
+                return res;
+            default:
+                abort();
+        }
+    }
+}
+
+AbstractValue AbstractValue::top( int bw )
+{
+    AbstractValue v;
+    v.bw = bw;
+    v.lo = 0;
+    v.hi = v.mask();
+    v.ones = 0;
+    v.zeros = v.wide() ? 0 : ~v.mask();
+    return v;
+}
+
+AbstractValue AbstractValue::constant( uint64_t value, int bw )
+{
+    AbstractValue v = top( bw );
+    if ( v.wide() )
+        return v;
+    value &= v.mask();
+    v.lo = v.hi = v.ones = value;
+    v.zeros = ~value;
+    return v;
+}
+
+AbstractValue AbstractValue::boolean( bool value )
+{
+    return constant( value, 0 );
+}
+
+AbstractValue AbstractValue::meet( const AbstractValue &o ) const
+{
+    if ( wide() )
+        return *this;
+    return make( bw, std::max( lo, o.lo ), std::min( hi, o.hi ),
+        zeros | o.zeros, ones | o.ones );
+}
+
+AbstractValue AbstractEnv::get( const Formula::Ident &id ) const
+{
+    auto it = vars.find( id );
+    return it == vars.end() ? AbstractValue::top( id.bw ) : it->second;
+}
+
+AbstractValue AbstractEnv::eval( const Formula &f ) const
+{
+    if ( f._rpn.empty() )
+        return AbstractValue::boolean( true );
+    return eval( f._rpn.begin(), f._rpn.end() );
+}
+
+AbstractValue AbstractEnv::eval( It begin, It end ) const
+{
+    const Item &i = *( end - 1 );
+    switch ( i.kind ) {
+        case Item::Constant:
+            return AbstractValue::constant( i.value, i.id.bw );
+        case Item::BoolVal:
+            return AbstractValue::boolean( i.value == 1 );
+        case Item::Identifier:
+            return get( i.id );
+        case Item::Op:
+            break;
+    }
+
+    if ( i.is_unary_op() ) {
+        AbstractValue v = eval( begin, end - 1 );
+        switch ( i.op ) {
+            case Item::Not:
+                return make( 0, 1 - v.hi, 1 - v.lo );
+            case Item::BNot:
+                if ( v.wide() )
+                    return v;
+                return make( v.bw, v.mask() - v.hi, v.mask() - v.lo, v.ones, v.zeros );
+            case Item::ZExt:
+                if ( v.wide() )
+                    return AbstractValue::top( i.value );
+                return make( i.value, v.lo, v.hi, v.zeros, v.ones );
+            case Item::SExt: {
+                int bw = i.value;
+                if ( v.wide() || bw > 64 )
+                    return AbstractValue::top( bw );
+                uint64_t sb = sign_bit( v );
+                if ( v.hi < sb )
+                    return make( bw, v.lo, v.hi, v.zeros, v.ones );
+                uint64_t ext = AbstractValue::top( bw ).mask() - v.mask();
+                if ( v.lo >= sb )
+                    return make( bw, v.lo + ext, v.hi + ext, 0, v.ones | ext );
+                return AbstractValue::top( bw );
+            }
+            case Item::Trunc: {
+                unsigned shift = i.value & 0xFFFF;
+                AbstractValue res = AbstractValue::top( ( i.value >> 16 ) - shift + 1 );
+                if ( v.wide() || res.wide() )
+                    return res;
+                uint64_t lo = v.lo >> shift, hi = v.hi >> shift;
+                uint64_t zeros = v.zeros >> shift, ones = v.ones >> shift;
+                if ( hi - lo <= res.mask() && ( lo & res.mask() ) <= ( hi & res.mask() ) )
+                    return make( res.bw, lo & res.mask(), hi & res.mask(), zeros, ones );
+                return make( res.bw, 0, res.mask(), zeros, ones );
+            }
+            default:
+                abort();
+        }
+    }
+
+    It middle = subformula( begin, end - 1 );
+    AbstractValue l = eval( begin, middle );
+    AbstractValue r = eval( middle, end - 1 );
+
+    if ( is_comparison( i.op ) )
+        return compare( i.op, l, r );
+
+    if ( i.op == Item::And )
+        return make( 0, std::min( l.lo, r.lo ), std::min( l.hi, r.hi ) );
+    if ( i.op == Item::Or )
+        return make( 0, std::max( l.lo, r.lo ), std::max( l.hi, r.hi ) );
+    if ( i.op == Item::Concat ) {
+        AbstractValue res = AbstractValue::top( l.bw + r.bw );
+        if ( res.wide() )
+            return res;
+        return make( res.bw, ( l.lo << r.bw ) + r.lo, ( l.hi << r.bw ) + r.hi,
+            ( l.zeros << r.bw ) | ( r.zeros & r.mask() ), ( l.ones << r.bw ) | r.ones );
+    }
+
+    if ( l.wide() || r.wide() )
+        return AbstractValue::top( l.bw );
+    int bw = l.bw;
+    uint64_t mask = l.mask();
+    uint64_t sb = bw ? sign_bit( l ) : 0;
+    switch ( i.op ) {
+        case Item::Plus:
+            if ( l.hi <= mask - r.hi )
+                return make( bw, l.lo + r.lo, l.hi + r.hi );
+            break;
+        case Item::Minus:
+            if ( l.lo >= r.hi )
+                return make( bw, l.lo - r.hi, l.hi - r.lo );
+            break;
+        case Item::Times:
+            if ( r.hi == 0 || l.hi <= mask / r.hi )
+                return make( bw, l.lo * r.lo, l.hi * r.hi );
+            break;
+        case Item::Div:
+            // Signed division of non-negative numbers
+            if ( l.hi < sb && r.hi < sb && r.lo > 0 )
+                return make( bw, l.lo / r.hi, l.hi / r.lo );
+            break;
+        case Item::SRem:
+            if ( l.hi < sb && r.hi < sb && r.lo > 0 )
+                return make( bw, 0, std::min( l.hi, r.hi - 1 ) );
+            break;
+        case Item::URem:
+            // x urem 0 is x
+            return make( bw, 0, r.lo > 0 ? std::min( l.hi, r.hi - 1 ) : l.hi );
+        case Item::BAnd:
+            return make( bw, 0, std::min( l.hi, r.hi ), l.zeros | r.zeros, l.ones & r.ones );
+        case Item::BOr:
+            return make( bw, std::max( l.lo, r.lo ), l.hi <= mask - r.hi ? l.hi + r.hi : mask,
+                l.zeros & r.zeros, l.ones | r.ones );
+        case Item::Xor:
+            if ( bw == 0 ) {
+                if ( l.lo == l.hi && r.lo == r.hi )
+                    return AbstractValue::boolean( l.lo != r.lo );
+                return unknown_bool();
+            }
+            return make( bw, 0, l.hi <= mask - r.hi ? l.hi + r.hi : mask,
+                ( l.zeros & r.zeros ) | ( l.ones & r.ones ),
+                ( l.ones & r.zeros ) | ( l.zeros & r.ones ) );
+        case Item::Shl:
+            if ( r.lo != r.hi )
+                break;
+            if ( r.lo >= uint64_t( bw ) )
+                return AbstractValue::constant( 0, bw );
+            if ( l.hi <= mask >> r.lo )
+                return make( bw, l.lo << r.lo, l.hi << r.lo,
+                    ( l.zeros << r.lo ) | ( ( uint64_t( 1 ) << r.lo ) - 1 ), l.ones << r.lo );
+            return make( bw, 0, mask,
+                ( l.zeros << r.lo ) | ( ( uint64_t( 1 ) << r.lo ) - 1 ), l.ones << r.lo );
+        case Item::Shr:
+            if ( r.lo != r.hi )
+                return make( bw, 0, l.hi );
+            if ( r.lo >= uint64_t( bw ) )
+                return AbstractValue::constant( 0, bw );
+            return make( bw, l.lo >> r.lo, l.hi >> r.lo,
+                ( l.zeros >> r.lo ) | ~( mask >> r.lo ), l.ones >> r.lo );
+        default:
+            abort();
+    }
+    return AbstractValue::top( bw );
+}
+
+bool AbstractEnv::refine( const Formula::Ident &id, const AbstractValue &v, bool &change )
+{
+    AbstractValue old = get( id );
+    AbstractValue res = old.meet( v );
+    if ( res.is_bottom() )
+        return false;
+    if ( res.lo != old.lo || res.hi != old.hi || res.zeros != old.zeros || res.ones != old.ones ) {
+        vars[ id ] = res;
+        change = true;
+    }
+    return true;
+}
+
+bool AbstractEnv::refine( It begin, It end, bool positive, bool &change )
+{
+    const Item &i = *( end - 1 );
+    if ( i.kind == Item::Op && i.op == Item::Not )
+        return refine( begin, end - 1, !positive, change );
+    if ( i.kind == Item::Op && ( ( i.op == Item::And && positive ) || ( i.op == Item::Or && !positive ) ) ) {
+        It middle = subformula( begin, end - 1 );
+        return refine( begin, middle, positive, change )
+            && refine( middle, end - 1, positive, change );
+    }
+
+    AbstractValue v = eval( begin, end );
+    if ( positive ? v.is_false() : v.is_true() )
+        return false;
+    if ( i.kind != Item::Op || !is_comparison( i.op ) )
+        return true;
+
+    It middle = subformula( begin, end - 1 );
+    Item::Operator op = positive ? i.op : negate( i.op );
+    // x op e or e op x
+    for ( int side = 0; side != 2; ++side ) {
+        It x_begin = side ? middle : begin;
+        It x_end = side ? end - 1 : middle;
+        if ( x_end - x_begin != 1 || x_begin->kind != Item::Identifier )
+            continue;
+        Item::Operator x_op = side ? swap( op ) : op;
+        AbstractValue x = get( x_begin->id );
+        AbstractValue e = side ? eval( begin, middle ) : eval( middle, end - 1 );
+        if ( x.wide() || e.wide() )
+            continue;
+        if ( !is_signed( x_op ) ) {
+            if ( !refine( x_begin->id, restrict_by( x_op, x, e ), change ) )
+                return false;
+            continue;
+        }
+        // The result has to lie in one half of the signed order to be an
+        // unsigned interval
+        uint64_t sb = sign_bit( x );
+        AbstractValue res = restrict_by( to_unsigned( x_op ), biased( x ), biased( e ) );
+        if ( res.is_bottom() )
+            return false;
+        if ( ( res.lo & sb ) == ( res.hi & sb ) ) {
+            if ( !refine( x_begin->id, make( x.bw, res.lo ^ sb, res.hi ^ sb ), change ) )
+                return false;
+        }
+    }
+    return true;
+}
+
+bool AbstractEnv::assume( const std::vector< Definition > &defs,
+    const std::vector< Formula > &pcs )
+{
+    return assume_all( defs, pcs );
+}
+
+bool AbstractEnv::assume( const std::vector< DefinitionRef > &defs,
+    const std::vector< const Formula * > &pcs )
+{
+    return assume_all( defs, pcs );
+}
+
+template < typename Defs, typename Pcs >
+bool AbstractEnv::assume_all( const Defs &defs, const Pcs &pcs )
+{
+    // Few rounds suffice to propagate bounds along the usual chains of
+    // definitions, the result is sound after any number of them
+    const int ROUNDS = 4;
+    for ( int round = 0; round != ROUNDS; ++round ) {
+        bool change = false;
+        for ( const auto &def : defs ) {
+            if ( !refine( symbol_of( def ), eval( definition_of( def ) ), change ) )
+                return false;
+        }
+        for ( const auto &p : pcs ) {
+            const Formula &pc = formula_of( p );
+            if ( !pc._rpn.empty() && !refine( pc._rpn.begin(), pc._rpn.end(), true, change ) )
+                return false;
+        }
+        if ( !change )
+            break;
+    }
+    return true;
+}
+
+}
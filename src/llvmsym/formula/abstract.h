@@ -0,0 +1,97 @@
+#pragma once
+
+#include <llvmsym/formula/rpn.h>
+
+#include <map>
+#include <vector>
+#include <cstdint>
+
+#define ABSTRACT_EMPTY "Empty queries decided by intervals"
+#define ABSTRACT_NOT_SUBSETEQ "Subseteq queries decided by intervals"
+
+namespace llvm_sym {
+
+/**
+ * Abstract value of an expression: an unsigned interval and known bits.
+ * Boolean expressions have width 0 and an interval within [0, 1]. Values
+ * wider than 64 bits are not tracked, they are always top.
+ */
+struct AbstractValue {
+    int bw;
+    uint64_t lo, hi;
+    uint64_t zeros, ones; // Bits known to be 0 and 1
+
+    static AbstractValue top( int bw );
+    static AbstractValue constant( uint64_t value, int bw );
+    static AbstractValue boolean( bool value );
+
+    uint64_t mask() const {
+        if ( bw == 0 )
+            return 1;
+        return bw >= 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << bw ) - 1;
+    }
+
+    bool wide() const {
+        return bw > 64;
+    }
+
+    bool is_bottom() const {
+        return lo > hi || ( zeros & ones ) != 0;
+    }
+
+    bool is_true() const {
+        return lo == 1;
+    }
+
+    bool is_false() const {
+        return hi == 0;
+    }
+
+    /**
+     * Intersection, the interval is tightened by the known bits
+     */
+    AbstractValue meet( const AbstractValue &o ) const;
+
+    bool disjoint( const AbstractValue &o ) const {
+        return !wide() && meet( o ).is_bottom();
+    }
+};
+
+/**
+ * Over-approximation of the values of variables constrained by definitions
+ * and path conditions. It is computed without the solver, so it can refute
+ * feasibility of the constraints or inclusion of states cheaply.
+ */
+class AbstractEnv {
+public:
+    // Definition given by reference, e.g. into the formula pool
+    typedef std::pair< Formula::Ident, const Formula * > DefinitionRef;
+
+    /**
+     * Refines the values of the variables by the constraints
+     * @return false if the constraints are certainly unsatisfiable
+     */
+    bool assume( const std::vector< Definition > &defs,
+        const std::vector< Formula > &pcs );
+
+    bool assume( const std::vector< DefinitionRef > &defs,
+        const std::vector< const Formula * > &pcs );
+
+    AbstractValue eval( const Formula &f ) const;
+
+    AbstractValue get( const Formula::Ident &id ) const;
+
+private:
+    typedef std::vector< Formula::Item >::const_iterator It;
+
+    template < typename Defs, typename Pcs >
+    bool assume_all( const Defs &defs, const Pcs &pcs );
+
+    AbstractValue eval( It begin, It end ) const;
+    bool refine( It begin, It end, bool positive, bool &change );
+    bool refine( const Formula::Ident &id, const AbstractValue &v, bool &change );
+
+    std::map< Formula::Ident, AbstractValue > vars;
+};
+
+}
@@ -3,6 +3,7 @@
 #include <ostream>
 #include <vector>
 #include <string>
+#include <algorithm>
 
 namespace llvm_sym {
 
@@ -50,5 +51,471 @@ std::ostream& operator <<(std::ostream& o, const Formula::Ident& id) {
     return o;
 }
 
+namespace {
+    struct EvalValue {
+        uint64_t value;
+        int bw; // 0 for booleans
+    };
+
+    uint64_t mask( uint64_t v, int bw )
+    {
+        return bw >= 64 || bw == 0 ? v : v & ( ( 1ull << bw ) - 1 );
+    }
+
+    int64_t to_signed( uint64_t v, int bw )
+    {
+        if ( bw < 64 && bw > 0 && ( v >> ( bw - 1 ) ) & 1 )
+            v |= ~( ( 1ull << bw ) - 1 );
+        return static_cast< int64_t >( v );
+    }
+
+    bool evalUnary( const Formula::Item &i, EvalValue &v )
+    {
+        switch ( i.op ) {
+            case Formula::Item::Not:
+                v.value = !v.value;
+                return true;
+            case Formula::Item::BNot:
+                v.value = mask( ~v.value, v.bw );
+                return true;
+            case Formula::Item::ZExt:
+                v.bw = i.value;
+                return v.bw <= 64;
+            case Formula::Item::SExt:
+                v.value = mask( to_signed( v.value, v.bw ), i.value );
+                v.bw = i.value;
+                return v.bw <= 64;
+            case Formula::Item::Trunc: {
+                int high = i.value >> 16;
+                int low = i.value & 0xFFFF;
+                v.bw = high - low + 1;
+                v.value = mask( v.value >> low, v.bw );
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    bool evalBinary( const Formula::Item &i, EvalValue &l, const EvalValue &r )
+    {
+        uint64_t a = l.value, b = r.value;
+        int64_t sa = to_signed( a, l.bw ), sb = to_signed( b, r.bw );
+        int bw = l.bw;
+
+        switch ( i.op ) {
+            case Formula::Item::Plus:  l.value = mask( a + b, bw ); return true;
+            case Formula::Item::Minus: l.value = mask( a - b, bw ); return true;
+            case Formula::Item::Times: l.value = mask( a * b, bw ); return true;
+            case Formula::Item::Div:
+                if ( sb == 0 )
+                    return false;
+                // Division of the minimal value by -1 overflows in C++
+                l.value = mask( sb == -1 ? 0 - a : sa / sb, bw );
+                return true;
+            case Formula::Item::SRem:
+                if ( sb == 0 )
+                    return false;
+                l.value = sb == -1 ? 0 : mask( sa % sb, bw );
+                return true;
+            case Formula::Item::URem:
+                if ( b == 0 )
+                    return false;
+                l.value = a % b;
+                return true;
+            case Formula::Item::BAnd: l.value = a & b; return true;
+            case Formula::Item::BOr:  l.value = a | b; return true;
+            case Formula::Item::Xor:  l.value = a ^ b; return true;
+            case Formula::Item::Shl:
+                l.value = b >= 64 ? 0 : mask( a << b, bw );
+                return true;
+            case Formula::Item::Shr:
+                l.value = b >= 64 ? 0 : a >> b;
+                return true;
+            case Formula::Item::Concat:
+                if ( l.bw + r.bw > 64 )
+                    return false;
+                l.value = ( a << r.bw ) | b;
+                l.bw += r.bw;
+                return true;
+            default:
+                break;
+        }
+
+        bool res;
+        switch ( i.op ) {
+            case Formula::Item::Eq:   res = a == b; break;
+            case Formula::Item::NEq:  res = a != b; break;
+            case Formula::Item::And:  res = a && b; break;
+            case Formula::Item::Or:   res = a || b; break;
+            case Formula::Item::LT:   res = sa < sb; break;
+            case Formula::Item::LEq:  res = sa <= sb; break;
+            case Formula::Item::GT:   res = sa > sb; break;
+            case Formula::Item::GEq:  res = sa >= sb; break;
+            case Formula::Item::ULT:  res = a < b; break;
+            case Formula::Item::ULEq: res = a <= b; break;
+            case Formula::Item::UGT:  res = a > b; break;
+            case Formula::Item::UGEq: res = a >= b; break;
+            default:
+                return false;
+        }
+        l.value = res;
+        l.bw = 0;
+        return true;
+    }
+}
+
+namespace {
+    typedef Formula::Item Item;
+
+    bool is_literal( const Formula &f )
+    {
+        return f.size() == 1
+            && ( f.top().kind == Item::Constant || f.top().kind == Item::BoolVal );
+    }
+
+    EvalValue literal_value( const Formula &f )
+    {
+        const Item &i = f.top();
+        if ( i.kind == Item::BoolVal )
+            return { i.value, 0 };
+        return { mask( i.value, i.id.bw ), i.id.bw };
+    }
+
+    Formula build_literal( const EvalValue &v )
+    {
+        if ( v.bw == 0 )
+            return Formula::buildBoolVal( v.value != 0 );
+        return Formula::buildConstant( v.value, v.bw );
+    }
+
+    bool is_constant( const Formula &f, uint64_t v )
+    {
+        return f.size() == 1 && f.top().kind == Item::Constant
+            && mask( f.top().value, f.top().id.bw ) == mask( v, f.top().id.bw );
+    }
+
+    bool is_bool( const Formula &f, bool v )
+    {
+        return f.size() == 1 && f.top().kind == Item::BoolVal
+            && ( f.top().value != 0 ) == v;
+    }
+
+    bool negate_comparison( Item::Operator op, Item::Operator &res );
+
+    /**
+     * Checks if b is negation of a, i.e. !a or a comparison negated by the
+     * normalization
+     */
+    bool is_negation( const Formula &a, const Formula &b )
+    {
+        if ( b.size() == a.size() + 1 )
+            return b.top().kind == Item::Op && b.top().op == Item::Not
+                && std::equal( a._rpn.begin(), a._rpn.end(), b._rpn.begin() );
+        Item::Operator neg;
+        return a.size() == b.size() && a.top().kind == Item::Op
+            && b.top().kind == Item::Op && negate_comparison( a.top().op, neg )
+            && neg == b.top().op
+            && std::equal( a._rpn.begin(), a._rpn.end() - 1, b._rpn.begin() );
+    }
+
+    bool is_commutative( Item::Operator op )
+    {
+        switch ( op ) {
+            case Item::Plus: case Item::Times: case Item::Eq: case Item::NEq:
+            case Item::And: case Item::Or: case Item::BAnd: case Item::BOr:
+            case Item::Xor:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Returns negated comparison, false if op is not a comparison
+     */
+    bool negate_comparison( Item::Operator op, Item::Operator &res )
+    {
+        switch ( op ) {
+            case Item::Eq:   res = Item::NEq;  return true;
+            case Item::NEq:  res = Item::Eq;   return true;
+            case Item::LT:   res = Item::GEq;  return true;
+            case Item::GEq:  res = Item::LT;   return true;
+            case Item::GT:   res = Item::LEq;  return true;
+            case Item::LEq:  res = Item::GT;   return true;
+            case Item::ULT:  res = Item::UGEq; return true;
+            case Item::UGEq: res = Item::ULT;  return true;
+            case Item::UGT:  res = Item::ULEq; return true;
+            case Item::ULEq: res = Item::UGT;  return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Returns the formula without its top operator
+     */
+    Formula operand( const Formula &f )
+    {
+        Formula res;
+        res._rpn.assign( f._rpn.begin(), f._rpn.end() - 1 );
+        return res;
+    }
+}
+
+int Formula::bitWidth() const
+{
+    std::vector< int > stack;
+    for ( const Item &i : _rpn ) {
+        switch ( i.kind ) {
+            case Item::Constant:
+            case Item::Identifier:
+                stack.push_back( i.id.bw );
+                break;
+            case Item::BoolVal:
+                stack.push_back( 0 );
+                break;
+            case Item::Op:
+                if ( i.is_unary_op() ) {
+                    int &w = stack.back();
+                    if ( i.op == Item::ZExt || i.op == Item::SExt )
+                        w = i.value;
+                    else if ( i.op == Item::Trunc )
+                        w = ( i.value >> 16 ) - ( i.value & 0xFFFF ) + 1;
+                    else if ( i.op == Item::Not )
+                        w = 0;
+                    break;
+                }
+                int r = stack.back();
+                stack.pop_back();
+                Item::Operator neg;
+                if ( i.op == Item::Concat )
+                    stack.back() += r;
+                else if ( i.op == Item::And || i.op == Item::Or
+                          || negate_comparison( i.op, neg ) )
+                    stack.back() = 0;
+                break;
+        }
+    }
+    return stack.empty() ? 0 : stack.back();
+}
+
+bool Formula::rewriteBinary( const Formula &l, const Formula &r,
+                             Item::Operator op, Formula &result )
+{
+    if ( l.size() == 0 || r.size() == 0 )
+        return false;
+
+    if ( is_literal( l ) && is_literal( r ) ) {
+        EvalValue a = literal_value( l );
+        Item i;
+        i.kind = Item::Op;
+        i.op = op;
+        if ( !evalBinary( i, a, literal_value( r ) ) )
+            return false;
+        result = build_literal( a );
+        return true;
+    }
+
+    // Literals go to the right
+    if ( is_literal( l ) && is_commutative( op ) ) {
+        result = joinBinary( r, l, op );
+        return true;
+    }
+
+    if ( l.size() == r.size()
+         && std::equal( l._rpn.begin(), l._rpn.end(), r._rpn.begin() ) )
+    {
+        switch ( op ) {
+            case Item::And: case Item::Or: case Item::BAnd: case Item::BOr:
+                result = l;
+                return true;
+            case Item::Eq: case Item::LEq: case Item::GEq: case Item::ULEq:
+            case Item::UGEq:
+                result = buildBoolVal( true );
+                return true;
+            case Item::NEq: case Item::LT: case Item::GT: case Item::ULT:
+            case Item::UGT:
+                result = buildBoolVal( false );
+                return true;
+            case Item::Minus: case Item::Xor: case Item::URem: case Item::SRem: {
+                // x % x is 0 even for x = 0 in the bit-vector semantics
+                int bw = l.bitWidth();
+                result = bw == 0 ? buildBoolVal( false ) : buildConstant( 0, bw );
+                return true;
+            }
+            default:
+                break;
+        }
+    }
+
+    if ( op == Item::And || op == Item::Or ) {
+        if ( is_negation( l, r ) || is_negation( r, l ) ) {
+            result = buildBoolVal( op == Item::Or );
+            return true;
+        }
+        if ( is_bool( r, op == Item::And ) ) {
+            result = l;
+            return true;
+        }
+        if ( is_bool( r, op == Item::Or ) ) {
+            result = r;
+            return true;
+        }
+        return false;
+    }
+
+    if ( ( op == Item::Eq || op == Item::NEq ) && r.size() == 1
+         && r.top().kind == Item::BoolVal )
+    {
+        result = is_bool( r, op == Item::Eq ) ? l : !l;
+        return true;
+    }
+
+    if ( r.size() != 1 || r.top().kind != Item::Constant )
+        return false;
+    uint64_t all_ones = mask( ~0ull, r.top().id.bw );
+    switch ( op ) {
+        case Item::Plus: case Item::Minus: case Item::BOr: case Item::Xor:
+        case Item::Shl: case Item::Shr:
+            if ( !is_constant( r, 0 ) )
+                return false;
+            result = l;
+            return true;
+        case Item::Times:
+            if ( is_constant( r, 0 ) )
+                result = r;
+            else if ( is_constant( r, 1 ) )
+                result = l;
+            else
+                return false;
+            return true;
+        case Item::Div:
+            if ( !is_constant( r, 1 ) )
+                return false;
+            result = l;
+            return true;
+        case Item::URem:
+        case Item::SRem:
+            if ( !is_constant( r, 1 ) )
+                return false;
+            result = buildConstant( 0, r.top().id.bw );
+            return true;
+        case Item::BAnd:
+            if ( is_constant( r, 0 ) )
+                result = r;
+            else if ( is_constant( r, all_ones ) )
+                result = l;
+            else
+                return false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Formula::rewriteUnary( const Formula &l, Item::Operator op, int value,
+                            Formula &result )
+{
+    if ( l.size() == 0 )
+        return false;
+
+    if ( is_literal( l ) ) {
+        EvalValue v = literal_value( l );
+        Item i;
+        i.kind = Item::Op;
+        i.op = op;
+        i.value = value;
+        if ( !evalUnary( i, v ) )
+            return false;
+        result = build_literal( v );
+        return true;
+    }
+
+    const Item &top = l.top();
+    bool top_op = top.kind == Item::Op;
+    switch ( op ) {
+        case Item::Not: {
+            Item::Operator neg;
+            if ( top_op && top.op == Item::Not ) {
+                result = operand( l );
+                return true;
+            }
+            if ( top_op && negate_comparison( top.op, neg ) ) {
+                result = l;
+                result.top().op = neg;
+                return true;
+            }
+            return false;
+        }
+        case Item::BNot:
+            if ( !top_op || top.op != Item::BNot )
+                return false;
+            result = operand( l );
+            return true;
+        case Item::ZExt:
+        case Item::SExt:
+            if ( l.bitWidth() == value ) {
+                result = l;
+                return true;
+            }
+            if ( top_op && top.op == op ) {
+                result = joinUnary( operand( l ), op, value );
+                return true;
+            }
+            return false;
+        case Item::Trunc:
+            if ( ( value & 0xFFFF ) == 0 && ( value >> 16 ) + 1 == l.bitWidth() ) {
+                result = l;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool Formula::evaluate( uint64_t &result, const Valuation &valuation ) const
+{
+    std::vector< EvalValue > stack;
+
+    for ( const Item &i : _rpn ) {
+        switch ( i.kind ) {
+            case Item::Constant:
+                stack.push_back( { mask( i.value, i.id.bw ), i.id.bw } );
+                break;
+            case Item::BoolVal:
+                stack.push_back( { i.value, 0 } );
+                break;
+            case Item::Identifier: {
+                EvalValue v;
+                if ( !valuation || !valuation( i.id, v.value, v.bw ) || v.bw > 64 )
+                    return false;
+                v.value = mask( v.value, v.bw );
+                stack.push_back( v );
+                break;
+            }
+            case Item::Op:
+                if ( i.is_unary_op() ) {
+                    assert( !stack.empty() );
+                    if ( !evalUnary( i, stack.back() ) )
+                        return false;
+                } else {
+                    assert( stack.size() >= 2 );
+                    EvalValue r = stack.back();
+                    stack.pop_back();
+                    if ( !evalBinary( i, stack.back(), r ) )
+                        return false;
+                }
+                break;
+        }
+    }
+
+    if ( stack.size() != 1 )
+        return false;
+    result = stack.back().value;
+    return true;
+}
+
 }
 
@@ -8,6 +8,7 @@
 #include <tuple>
 #include <z3++.h>
 #include <map>
+#include <functional>
 
 namespace llvm_sym {
 
@@ -117,8 +118,10 @@ struct Formula {
                 return false;
             if ( kind == Kind::Identifier )
                 return id == snd.id;
-            if ( kind == Kind::Op )
-                return op == snd.op;
+            if ( kind == Kind::Op ) // Only unary operators have a parameter
+                return op == snd.op && ( !is_unary_op() || value == snd.value );
+            if ( kind == Kind::Constant )
+                return value == snd.value && id.bw == snd.id.bw;
             else
                 return value == snd.value;
         }
@@ -365,6 +368,23 @@ struct Formula {
         return substitute( id, definition );
     }
 
+    /**
+     * Local rewriting applied when a formula is built: constant folding,
+     * algebraic identities (x + 0, x - x, x == x, ...) and boolean
+     * normalization (no negations of comparisons, constants on the right of
+     * commutative operators). Operands are expected to be rewritten already.
+     * @return false if no rule applies
+     */
+    static bool rewriteBinary( const Formula &l, const Formula &r,
+                               Item::Operator op, Formula &result );
+    static bool rewriteUnary( const Formula &l, Item::Operator op, int value,
+                              Formula &result );
+
+    /**
+     * Returns bit width of the formula, 0 for booleans
+     */
+    int bitWidth() const;
+
     static Formula joinBinary( const Formula &l, const Formula &r, Item::Operator op )
     {
         if ( op == Item::And && l.size() == 0 )
@@ -372,6 +392,8 @@ struct Formula {
         if ( op == Item::And && r.size() == 0 )
             return l;
         Formula result;
+        if ( rewriteBinary( l, r, op, result ) )
+            return result;
 
         result._rpn.reserve( l._rpn.size() + r._rpn.size() + 1 );
         result.append( l );
@@ -391,6 +413,8 @@ struct Formula {
     static Formula joinUnary( const Formula &l, Item::Operator op, int value = 0 )
     {
         Formula result;
+        if ( rewriteUnary( l, op, value, result ) )
+            return result;
 
         result._rpn.reserve( l._rpn.size() + 1 );
         result.append( l );
@@ -597,6 +621,20 @@ struct Formula {
         return joinUnary( *this, Item::Not);
     }
 
+    /**
+     * Callback providing value and bit width of an identifier, returns false
+     * if the value is not known
+     */
+    typedef std::function< bool ( const Ident &, uint64_t &, int & ) > Valuation;
+
+    /**
+     * Evaluates the formula with identifiers replaced by values given by
+     * valuation. Booleans are evaluated to 0 or 1.
+     * @return false if some identifier has no value or the result is not
+     *         defined (e.g. division by zero)
+     */
+    bool evaluate( uint64_t &result, const Valuation &valuation = Valuation() ) const;
+
     void collect_variables(  std::vector< Ident > &ret) const
     {
         for ( const auto &i : _rpn ) {
@@ -605,6 +643,15 @@ struct Formula {
         }
     }
 
+    template < typename F >
+    void for_each_identifier( const F &f )
+    {
+        for ( auto &i : _rpn ) {
+            if ( i.kind == Item::Kind::Identifier )
+                f( i.id );
+        }
+    }
+
     bool findIsomorphicVariableMapping(
             const Formula &snd,
             std::map< Ident, Ident > &mapping ) const
@@ -1,5 +1,7 @@
 #include <llvmsym/formula/z3.h>
 #include <llvmsym/programutils/config.h>
+#include <llvmsym/programutils/statistics.h>
+#include <toolkit/z3cache.h>
 #include <z3.h>
 
 namespace llvm_sym {
@@ -233,6 +235,23 @@ const Formula fromz3( const z3::expr &expr )
         assert( ss.str() == "true" || ss.str() == "false" );
         return Formula::buildBoolVal( ss.str() == "true" );
     } else if ( is_app ) {
+        // Associative operators may have more arguments, e.g. results of qe
+        Z3_decl_kind kind = expr.decl().decl_kind();
+        if ( expr.num_args() > 2 && ( kind == Z3_OP_AND || kind == Z3_OP_OR
+            || kind == Z3_OP_BADD || kind == Z3_OP_BMUL ) )
+        {
+            Formula res = fromz3( expr.arg( 0 ) );
+            for ( unsigned i = 1; i < expr.num_args(); ++i ) {
+                Formula r = fromz3( expr.arg( i ) );
+                switch ( kind ) {
+                    case Z3_OP_AND:  res = res && r; break;
+                    case Z3_OP_OR:   res = res || r; break;
+                    case Z3_OP_BADD: res = res + r; break;
+                    default:         res = res * r; break;
+                }
+            }
+            return res;
+        }
         switch( expr.num_args() ) {
             case 2: {
                 Formula l = fromz3( expr.arg( 0 ) ), r = fromz3( expr.arg( 1 ) );
@@ -337,6 +356,56 @@ z3::expr exists( const std::vector< z3::expr > &v, const z3::expr & b )
     return z3::expr(b.ctx(), r);
 }
 
+static bool has_quantifier( const z3::expr &e )
+{
+    if ( e.is_quantifier() )
+        return true;
+    if ( !e.is_app() )
+        return false;
+    for ( unsigned i = 0; i < e.num_args(); ++i ) {
+        if ( has_quantifier( e.arg( i ) ) )
+            return true;
+    }
+    return false;
+}
+
+bool eliminate_quantifiers( const z3::expr &f, Formula &res, unsigned timeout,
+    size_t max_size )
+{
+    z3::context &ctx = f.ctx();
+    try {
+        z3::tactic qe = z3::try_for(
+            z3::tactic( ctx, "qe-light" ) & z3::tactic( ctx, "qe" ), timeout );
+        z3::goal goal_f( ctx );
+        goal_f.add( f );
+        z3::apply_result result = qe.apply( goal_f );
+
+        // The subgoals form a disjunction, each of them takes an item at least
+        if ( result.size() > max_size )
+            return false;
+        z3::expr result_expr = ctx.bool_val( false );
+        for ( unsigned g = 0; g < result.size(); ++g ) {
+            z3::expr goal = ctx.bool_val( true );
+            for ( unsigned e = 0; e < result[ g ].size(); ++e )
+                goal = goal && result[ g ][ e ];
+            result_expr = result_expr || goal;
+        }
+        if ( has_quantifier( result_expr ) )
+            return false;
+        Formula eliminated = fromz3( result_expr.simplify() );
+        if ( eliminated._rpn.size() > max_size )
+            return false;
+        res = eliminated;
+        return true;
+    }
+    catch ( const z3::exception & ) {
+        return false; // Timeout
+    }
+    catch ( const std::exception & ) {
+        return false; // Not representable by Formula
+    }
+}
+
 Formula simplify( const z3::expr f, std::string tactics )
 {
     z3::context &ctx = f.ctx();
@@ -368,10 +437,16 @@ Formula simplify( const Formula &f )
 {
     if ( f.size() == 0 )
         return f;
+    // Sibling states share prefixes of their path conditions, so the same
+    // formula is simplified many times
+    if ( SimplifyCache.is_cached( f ) )
+        return SimplifyCache.result();
     z3::context ctx;
     
     try {
-        return simplify(toz3(f, 'a', ctx), "ctx-solver-simplify");
+        Formula res = simplify(toz3(f, 'a', ctx), "ctx-solver-simplify");
+        SimplifyCache.place( f, res );
+        return res;
     }
     catch (std::exception e) {
         if (Config.is_set("--verbose") || Config.is_set("--vverbose"))
@@ -386,6 +461,131 @@ Formula simplify( const Formula &f )
 
 }
 
+namespace {
+    /**
+     * Prefix of a path condition converted to z3. It is shared by all calls
+     * of simplify_incremental and path conditions of successive states
+     * usually share most of their prefix, so only a few conjuncts are
+     * converted on each call.
+     */
+    struct PrefixContext {
+        z3::context ctx;
+        std::vector< Formula > converted;
+        std::vector< z3::expr > exprs;
+
+        void convert( const std::vector< Formula > &pc, size_t prefix )
+        {
+            size_t common = 0;
+            while ( common < converted.size() && common < prefix
+                    && converted[ common ]._rpn == pc[ common ]._rpn )
+                ++common;
+            converted.resize( common );
+            exprs.erase( exprs.begin() + common, exprs.end() );
+            for ( size_t i = common; i < prefix; ++i ) {
+                exprs.push_back( toz3( pc[ i ], 'a', ctx ) );
+                converted.push_back( pc[ i ] );
+            }
+        }
+
+        void reset()
+        {
+            converted.clear();
+            exprs.clear();
+        }
+    };
+
+    /**
+     * Simplifies conjunct pc[ i ] by ctx-simplify in the context of the
+     * conjuncts preceding it. The tactic may also use the conjunct to rewrite
+     * the prefix, the whole prefix is replaced by the simplified goal then.
+     * @return number of leading conjuncts of pc which are simplified now,
+     *         the conjunct is kept as is if the tactic fails
+     */
+    size_t simplify_in_context( std::vector< Formula > &pc, size_t i )
+    {
+        static PrefixContext pctx;
+        try {
+            pctx.convert( pc, i );
+            z3::goal goal( pctx.ctx );
+            for ( const z3::expr &e : pctx.exprs )
+                goal.add( e );
+            // The goal splits conjunctions, compare the prefix as added
+            unsigned prefix = goal.size();
+            std::vector< z3::expr > before;
+            for ( unsigned k = 0; k < prefix; ++k )
+                before.push_back( goal[ k ] );
+            goal.add( toz3( pc[ i ], 'a', pctx.ctx ) );
+
+            z3::apply_result result = z3::tactic( pctx.ctx, "ctx-simplify" ).apply( goal );
+            if ( result.size() != 1 )
+                return i + 1;
+            z3::goal simplified = result[ 0 ];
+
+            bool same_prefix = simplified.size() >= prefix;
+            for ( unsigned k = 0; k < prefix && same_prefix; ++k )
+                same_prefix = z3::eq( simplified[ k ], before[ k ] );
+
+            z3::expr conj = pctx.ctx.bool_val( true );
+            bool implied = true;
+            for ( unsigned k = same_prefix ? prefix : 0; k < simplified.size(); ++k ) {
+                // ctx-simplify substitutes, the rewriter evaluates the result
+                z3::expr e = simplified[ k ].simplify();
+                switch ( is_const( e ) ) {
+                    case TriState::TRUE:
+                        continue;
+                    case TriState::FALSE:
+                        ++Statistics::getCounter( SIMP_CONTRADICTION );
+                        pc.assign( 1, Formula::buildBoolVal( false ) );
+                        return 1;
+                    case TriState::UNKNOWN:
+                        conj = implied ? e : conj && e;
+                        implied = false;
+                }
+            }
+
+            if ( same_prefix ) {
+                if ( implied ) {
+                    ++Statistics::getCounter( SIMP_IMPLIED );
+                    pc.erase( pc.begin() + i );
+                    return i;
+                }
+                pc[ i ] = fromz3( conj );
+                return i + 1;
+            }
+
+            pc.erase( pc.begin(), pc.begin() + i + 1 );
+            if ( !implied )
+                pc.insert( pc.begin(), fromz3( conj ) );
+            return implied ? 0 : 1;
+        }
+        catch ( const std::exception & ) {
+            pctx.reset();
+        }
+        catch ( const z3::exception & ) {
+            pctx.reset();
+        }
+        return i + 1;
+    }
+}
+
+void simplify_incremental( std::vector< Formula > &path_condition, size_t simplified )
+{
+    if ( path_condition.empty() )
+        return;
+
+    if ( simplified == 0 || path_condition.size() >= FULL_SIMPLIFY_PERIOD ) {
+        ++Statistics::getCounter( SIMP_FULL );
+        Formula conj;
+        for ( const Formula &pc : path_condition )
+            conj = conj && pc;
+        path_condition.assign( 1, simplify( conj ) );
+        return;
+    }
+
+    while ( simplified < path_condition.size() )
+        simplified = simplify_in_context( path_condition, simplified );
+}
+
 Formula cheap_simplify( const Formula &f )
 {
     if ( f.size() == 0 )
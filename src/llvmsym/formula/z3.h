@@ -6,8 +6,18 @@
 #include <toolkit/utils.h>
 #include <vector>
 
+#define SIMP_FULL "Full path condition simplifications"
+#define SIMP_IMPLIED "Conjuncts implied by path condition"
+#define SIMP_CONTRADICTION "Conjuncts contradicting path condition"
+
 namespace llvm_sym {
 
+/**
+ * Number of conjuncts of a path condition which triggers its full
+ * simplification in simplify_incremental
+ */
+const size_t FULL_SIMPLIFY_PERIOD = 16;
+
 z3::expr forall( const std::vector< z3::expr > &v, const z3::expr & b );
 z3::expr exists( const std::vector< z3::expr > &v, const z3::expr & b );
 
@@ -21,5 +31,25 @@ Formula simplify( const Formula &f );
 Formula cheap_simplify( const Formula &f );
 Formula simplify( const z3::expr f, std::string tactics );
 
+/**
+ * Eliminates the quantifiers of f by qe-light and qe tactics
+ * @param timeout in ms
+ * @param max_size maximal number of items of the result
+ * @return false if it did not succeed in time, the result is larger than
+ *         max_size or it cannot be expressed as Formula, res is unchanged then
+ */
+bool eliminate_quantifiers( const z3::expr &f, Formula &res, unsigned timeout,
+    size_t max_size );
+
+/**
+ * Simplifies the conjuncts of given path condition from index simplified on,
+ * i.e. the ones pushed since its last simplification, each by ctx-simplify in
+ * the context of the conjuncts preceding it. A conjunct is dropped if it simplifies to true, the path
+ * condition becomes false if a conjunct simplifies to false. The whole path
+ * condition is simplified by the solver when none of its conjuncts is
+ * simplified yet or when it reaches FULL_SIMPLIFY_PERIOD conjuncts.
+ */
+void simplify_incremental( std::vector< Formula > &path_condition, size_t simplified );
+
 }
 
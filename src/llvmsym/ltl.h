@@ -1,10 +1,15 @@
 #pragma once
 #include <string>
 #include <stack>
+#include <deque>
 #include "evaluator.h"
 #include "datastore.h"
 #include "blobing.h"
 #include "../toolkit/ltl2ba.h"
+#include "../toolkit/z3cache.h"
+#include "../toolkit/checkpoint.h"
+#include "../toolkit/owcty.h"
+#include "../toolkit/space_writer.h"
 
 class LtlException : public std::runtime_error {
 public:
@@ -20,6 +25,9 @@ public:
     Ltl(const std::string& model, const std::string& prop, bool depth_bound = false);
     void run(int max_depth = -1);
     void output_state_space(const std::string& filename);
+    size_t state_count() {
+        return knowns.size();
+    }
 private:
     typedef typename Ltl2ba<DummyTranslator>::index_type index_type;
     enum class VertexColor { WHITE, GRAY, BLACK };
@@ -27,33 +35,77 @@ private:
         VertexInfo(VertexColor outer = VertexColor::WHITE,
                    VertexColor inner = VertexColor::WHITE,
                    size_t depth = 0)
-            : outer_color(outer), inner_color(inner), depth(depth) {}
-        
-        void reset() {
-            outer_color = inner_color = VertexColor::WHITE;
-        }
+            : outer_color(outer), inner_color(inner), depth(depth),
+              accepting(false), scc_closed(false) {}
 
         VertexColor outer_color;
         VertexColor inner_color;
         size_t      depth;
+        bool        accepting; // Set when the outer DFS backtracks the vertex
+        bool        scc_closed; // The SCC of the vertex cannot grow any more
     };
 
     Evaluator<Store> eval; // Evaluator for the bitcode
     bool depth_bounded; // Use iterative DFS?
     Ltl2ba<LtlTranslator> ba; // Buchi automaton for given property
-    Database<Blob, Store, LinearCandidate<Store, Hit>, blobHashExplicitUserPart,
-        blobEqualExplicitUserPart> knowns; // Database of the states
-    Graph<StateId, VertexInfo> graph; // Graph of the state space
+    Database<Blob, Store, LinearCandidate<Store, Hit>> knowns; // Database of the states
+    Graph<StateId, VertexInfo> graph; // Graph of the state space, not spilled
+    Checkpointer checkpoint;
+    SpaceWriter space; // Streamed state space (--space_stream)
 
     /**
-     * Runs nested DFS with given initial state
+     * State of the outer DFS which is preserved in checkpoints
      */
-    void run_nested_dfs(StateId start_vertex, int max_depth);
-    
+    struct OuterDfs {
+        OuterDfs() : depth_bound(32), depth_bound_reached(false),
+            continued(false) {}
+
+        std::vector<std::vector<StateId>> stack;
+        size_t depth_bound;
+        bool   depth_bound_reached;
+        bool   continued; // The pass continues from the previous frontier
+        std::vector<StateId> frontier; // Vertices cut by the depth bound
+        std::vector<StateId> seeds; // Vertices the continued pass started from
+    };
+
+    /**
+     * Runs nested DFS with given initial state, continues from dfs if it is
+     * not empty
+     */
+    void run_nested_dfs(StateId start_vertex, int max_depth, OuterDfs dfs = OuterDfs());
+
+    /**
+     * Runs single pass SCC-based (Couvreur's) emptiness check from given
+     * vertices, reports the accepting cycle as soon as an accepting SCC is
+     * merged. With explored_only, only the graph explored by the outer DFS
+     * is checked and no successors are generated. The SCCs which cannot
+     * reach an unexpanded vertex are then marked as closed and skipped by
+     * the later checks, they cannot gain new edges.
+     * @return true if accepting cycle is found
+     */
+    bool run_scc(const std::vector<StateId>& seeds, bool explored_only = false);
+
     /**
-     * Resets DFS state, so next iteration can be started
+     * Returns true if the BA state of given vertex is accepting
      */
-    void reset_dfs();
+    bool is_accepting(StateId vertex_id);
+
+    /**
+     * Generates the whole product graph and searches it for an accepting
+     * cycle using parallel OWCTY
+     */
+    void run_owcty(StateId start_vertex);
+
+    /**
+     * Serializes the exploration state
+     */
+    void snapshot(SnapshotWriter& w, StateId start_vertex, const OuterDfs& dfs);
+
+    /**
+     * Restores the exploration state from given checkpoint file
+     * @return initial vertex of the exploration
+     */
+    StateId resume(const std::string& filename, OuterDfs& dfs);
 
     /**
      * Run inner pass of nested DFS
@@ -66,6 +118,11 @@ private:
      * return their Ids
      */
     std::vector<StateId> generate_successors(StateId vertex_id);
+
+    /**
+     * Returns description of the state loaded in the evaluator
+     */
+    std::string state_label(const StateId& vertex_id, index_type ba_state);
 };
 
 #include "ltl.tpp"
\ No newline at end of file
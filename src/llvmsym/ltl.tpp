@@ -4,12 +4,25 @@ template <class Store, class Hit>
 Ltl<Store, Hit>::Ltl(const std::string& model_name, const std::string& prop,
     bool depth_bounded)
 	: eval(std::make_shared<BitCode>(model_name)), depth_bounded(depth_bounded),
-      ba("! (" + prop + ")")
+      ba("! (" + prop + ")"),
+      checkpoint(Config.is_set("--checkpoint") ? Config.get_string("--checkpoint") : "",
+          Config.get_long("--checkpoint-interval")),
+      space(Config.is_set("--space_stream") ? Config.get_string("--space_stream") : "",
+          "ltl")
 {
+    if (Config.is_set("--mem-limit"))
+        knowns.set_mem_limit(Config.get_long("--mem-limit") << 20);
 }
 
 template <class Store, class Hit>
 void Ltl<Store, Hit>::run(int max_depth) {
+    if (Config.is_set("--resume")) {
+        OuterDfs dfs;
+        StateId start = resume(Config.get_string("--resume"), dfs);
+        run_nested_dfs(start, max_depth, dfs);
+        return;
+    }
+
 	// Init blob and reserve space for info about BA state in user section
 	Blob initial(eval.getSize()
 		+ sizeof(index_type), eval.getExplicitSize(), sizeof(index_type));
@@ -24,17 +37,32 @@ void Ltl<Store, Hit>::run(int max_depth) {
 	initial.user_as<index_type>() = ba_start;
 
 	// Insert initial state to database and start point of the buchi automaton
-	StateId initial_id = knowns.insert(initial);
+	StateId initial_id = knowns.insert(initial, eval.getExplicitChunks());
 	graph.add_vertex(initial_id);
 
-	run_nested_dfs(initial_id, max_depth);
-}
+    if (Config.is_set("--owcty")) {
+        run_owcty(initial_id);
+        return;
+    }
 
-template <class Store, class Hit>
-void Ltl<Store, Hit>::reset_dfs() {
-    graph.transform_vertices([&](VertexInfo& info) {
-        info.reset();
-    });
+    if (Config.is_set("--scc")) {
+        bool accepting_found = run_scc({ initial_id });
+        if (Config.is_set("--statistics")) {
+            std::cout << "States count\n"
+                "------------\n";
+            std::cout << knowns.size() << "\n";
+            knowns.dump_stat(std::cout);
+            std::cout << "\n";
+        }
+
+        if (accepting_found)
+            std::cout << "Property violated!\n";
+        else
+            std::cout << "Property holds!\n";
+        return;
+    }
+
+	run_nested_dfs(initial_id, max_depth);
 }
 
 template <class Store, class Hit>
@@ -43,19 +71,48 @@ std::vector<StateId> Ltl<Store, Hit>::generate_successors(StateId vertex_id)
     Blob state = knowns.getState(vertex_id);
 
     // Get successors of current BA states
-    auto ba_graph = ba.get_ba();
+    const auto& ba_graph = ba.get_ba();
     index_type ba_state = state.user_as<index_type>();
-    auto ba_succ = ba_graph.get_successors(ba_state);
-    auto ba_pc = ba_graph.get_successors_edges(ba_state);
+    const auto& ba_succ = ba_graph.get_successors(ba_state);
+    const auto& ba_pc = ba_graph.get_successors_edges(ba_state);
+
+    if (space.enabled()) {
+        std::string label;
+        if (Config.is_set("--space_labels")) {
+            eval.read(state.getExpl());
+            label = state_label(vertex_id, ba_state);
+        }
+        space.vertex(vertex_id.exp_id, vertex_id.sym_id, ba_state, label);
+    }
+
+    // Group BA edges by their guards, each guard is then decided and the
+    // program successors are generated only once per program state
+    std::vector<std::pair<const Formula*, std::vector<index_type>>> guards;
+    for (size_t i = 0; i != ba_succ.size(); i++) {
+        auto group = std::find_if(guards.begin(), guards.end(),
+            [&](const std::pair<const Formula*, std::vector<index_type>>& g) {
+                return g.first->_rpn == ba_pc[i].ap._rpn;
+            });
+        if (group == guards.end())
+            guards.push_back({ &ba_pc[i].ap, { ba_succ[i] } });
+        else
+            group->second.push_back(ba_succ[i]);
+    }
 
     std::vector<StateId> successors;
 
     // Make product with the BA
-    for (size_t i = 0; i != ba_succ.size(); i++) {
+    for (const auto& guard : guards) {
         eval.read(state.getExpl());
-        // Push proposition guard 
-        eval.getState()->data.pushPropGuard(ba_pc[i].ap);
-        eval.getState()->properties.empty |= eval.getState()->data.empty();
+
+        // Guards over explicit variables are decided without the solver
+        TriState decided = eval.decideGuard(*guard.first);
+        if (decided == TriState::FALSE)
+            continue;
+        if (decided == TriState::UNKNOWN) {
+            eval.getState()->data.pushPropGuard(*guard.first);
+            eval.getState()->properties.empty |= eval.getState()->data.empty();
+        }
 
         eval.advance([&]() {
             if (eval.is_empty())
@@ -64,13 +121,19 @@ std::vector<StateId> Ltl<Store, Hit>::generate_successors(StateId vertex_id)
             Blob newSucc(eval.getSize() + sizeof(index_type),
                 eval.getExplicitSize(), sizeof(index_type));
             eval.write(newSucc.getExpl());
-            newSucc.user_as<index_type>() = ba_succ[i]; // Update BA state
+            auto chunks = eval.getExplicitChunks();
 
-            if (Config.is_set("--verbose")) {
-                std::cout << "New succ produced\n";
+            for (index_type ba_target : guard.second) {
+                newSucc.user_as<index_type>() = ba_target; // Update BA state
+
+                if (Config.is_set("--verbose")) {
+                    std::cout << "New succ produced\n";
+                }
+                auto successor_id = knowns.insertCheck(newSucc, chunks).second;
+                successors.push_back(successor_id);
+                space.edge(vertex_id.exp_id, vertex_id.sym_id,
+                    successor_id.exp_id, successor_id.sym_id);
             }
-            auto successor_id = knowns.insertCheck(newSucc).second;
-            successors.push_back(successor_id);
         });
     }
     
@@ -78,30 +141,71 @@ std::vector<StateId> Ltl<Store, Hit>::generate_successors(StateId vertex_id)
 }
 
 template <class Store, class Hit>
-void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth) {
+std::string Ltl<Store, Hit>::state_label(const StateId& vertex_id,
+    index_type ba_state)
+{
+    std::stringstream s;
+    auto* state = eval.getState();
+    s << "<" << vertex_id.exp_id << ", " << vertex_id.sym_id << ", " << ba_state
+      << ">\n" << state->control << "\n" << state->explicitData << "\n"
+      << state->data;
+    return s.str();
+}
+
+template <class Store, class Hit>
+void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth,
+    OuterDfs dfs)
+{
 	if (!graph.exists(start_vertex))
 		throw LtlException("Initial vertex not found!");
 
-	std::stack<std::vector<StateId>> to_process;
-    to_process.push({ start_vertex });
+    auto& to_process = dfs.stack;
+    if (to_process.empty())
+        to_process.push_back({ start_vertex });
 
 	bool accepting_found     = false;
-    bool depth_bound_reached = false;
-    size_t depth_bound       = 32;
+    bool& depth_bound_reached = dfs.depth_bound_reached;
+    size_t& depth_bound       = dfs.depth_bound;
 
 	while (!accepting_found && !to_process.empty()) {
-        auto& top = to_process.top();
+        if (checkpoint.due()) {
+            // The writer thread must not run during the fork
+            space.suspend();
+            checkpoint.write([&](SnapshotWriter& w) {
+                snapshot(w, start_vertex, dfs);
+            });
+            space.resume();
+        }
+
+        auto& top = to_process.back();
         if (top.empty()) { // No successors left
-            to_process.pop();
-            if (depth_bounded && to_process.empty() && depth_bound_reached &&
+            to_process.pop_back();
+            if (!to_process.empty())
+                continue;
+
+            // End of the pass. A pass continuing from the frontier is not
+            // a single DFS, so the inner DFS misses cycles closed through
+            // vertices expanded after their accepting vertex was backtracked
+            // and the explored graph is checked by SCCs. A new cycle passes
+            // through a vertex expanded in this pass, so it is reachable from
+            // the vertices the pass started from.
+            if (dfs.continued)
+                accepting_found = run_scc(dfs.seeds, true);
+
+            if (!accepting_found && depth_bounded && depth_bound_reached &&
                 (max_depth == -1 || depth_bound < (size_t)max_depth))
             {
-                reset_dfs();
+                // Continue from the frontier, explored vertices stay black.
+                // The inner colors are kept as well, the inner DFS only looks
+                // for cycles early and the SCC check above is complete.
                 depth_bound *= 2;
                 if (max_depth != -1)
                     depth_bound = std::min(depth_bound, (size_t)max_depth);
                 depth_bound_reached = false;
-                to_process.push({ start_vertex });
+                dfs.continued = true;
+                dfs.seeds = dfs.frontier;
+                to_process.push_back(std::move(dfs.frontier));
+                dfs.frontier.clear();
                 std::cout << "   Starting new depth " << depth_bound << "\n"
                     "============================\n";
             }
@@ -112,8 +216,10 @@ void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth) {
 
         // Check depth bound
         if (depth_bounded && info.depth >= depth_bound) {
-            to_process.pop();
+            top.pop_back();
             depth_bound_reached = true;
+            if (info.outer_color == VertexColor::WHITE)
+                dfs.frontier.push_back(vertex_id);
             continue;
         }      
         
@@ -133,7 +239,7 @@ void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth) {
                 graph.add_successors(vertex_id, successors,
                     successors_info, std::vector<NoInfo>(successors_info.size()));
 			}
-            to_process.push(successors);
+            to_process.push_back(successors);
 
             info.outer_color = VertexColor::GRAY;
 		}
@@ -150,8 +256,10 @@ void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth) {
 
 			// Backtrack and check if the BA state is accepting
 			index_type ba_vertex = b.user_as<index_type>();
-			if (ba.get_ba().get_vertex_info(ba_vertex))
+			if (ba.get_ba().get_vertex_info(ba_vertex)) {
+                info.accepting = true;
 				accepting_found |= run_inner_dfs(vertex_id);
+            }
 			if (accepting_found)
 				break;
 		}
@@ -168,7 +276,9 @@ void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth) {
     if (Config.is_set("--statistics")) {
         std::cout << "States count\n"
             "------------\n";
-        std::cout << knowns.size() << "\n\n";
+        std::cout << knowns.size() << "\n";
+        knowns.dump_stat(std::cout);
+        std::cout << "\n";
     }
 
 	if (accepting_found)
@@ -177,6 +287,222 @@ void Ltl<Store, Hit>::run_nested_dfs(StateId start_vertex, int max_depth) {
 		std::cout << "Property holds!\n";
 }
 
+template <class Store, class Hit>
+bool Ltl<Store, Hit>::is_accepting(StateId vertex_id) {
+    Blob b = knowns.getState(vertex_id);
+    return ba.get_ba().get_vertex_info(b.user_as<index_type>());
+}
+
+template <class Store, class Hit>
+bool Ltl<Store, Hit>::run_scc(const std::vector<StateId>& seeds,
+    bool explored_only)
+{
+    struct Root {
+        size_t index;   // DFS number of the root of the SCC
+        bool accepting; // SCC contains accepting vertex
+        bool open;      // SCC reaches a vertex not expanded yet
+    };
+    struct Frame {
+        StateId vertex;
+        std::vector<StateId> successors;
+        size_t next;
+    };
+
+    // DFS numbers of visited vertices, 0 for vertices of closed SCCs
+    std::unordered_map<StateId, size_t> number;
+    std::vector<Root> roots;
+    std::vector<StateId> live; // Vertices of the SCCs that are not closed yet
+    std::vector<Frame> to_process;
+    size_t count = 0;
+
+    auto push = [&](StateId vertex_id) {
+        number[vertex_id] = ++count;
+        live.push_back(vertex_id);
+
+        std::vector<StateId> successors;
+        bool accepting;
+        bool open = false;
+        if (explored_only) {
+            // Vertices not expanded by the outer DFS have no successors yet
+            const VertexInfo& info = graph.get_vertex_info(vertex_id);
+            accepting = info.accepting;
+            if (info.outer_color == VertexColor::BLACK)
+                successors = graph.get_successors(vertex_id);
+            else
+                open = true;
+        }
+        else {
+            accepting = is_accepting(vertex_id);
+            successors = graph.get_successors(vertex_id);
+            if (successors.empty()) {
+                successors = generate_successors(vertex_id);
+                graph.add_successors(vertex_id, successors);
+            }
+        }
+        roots.push_back({ count, accepting, open });
+        to_process.push_back({ vertex_id, successors, 0 });
+    };
+
+    // Vertices of the SCCs closed by the previous checks are skipped
+    auto closed_before = [&](StateId vertex_id) {
+        return explored_only && graph.get_vertex_info(vertex_id).scc_closed;
+    };
+
+    for (StateId seed : seeds) {
+        if (number.count(seed) || closed_before(seed))
+            continue;
+        push(seed);
+        while (!to_process.empty()) {
+            Frame& top = to_process.back();
+            if (top.next != top.successors.size()) {
+                StateId succ = top.successors[top.next++];
+                if (closed_before(succ))
+                    continue;
+                auto res = number.find(succ);
+                if (res == number.end()) {
+                    push(succ);
+                    continue;
+                }
+                if (res->second == 0) { // Closed SCC
+                    roots.back().open |= explored_only
+                        && !graph.get_vertex_info(succ).scc_closed;
+                    continue;
+                }
+
+                // Cycle found, merge all SCCs on it
+                bool accepting = false;
+                bool open = false;
+                while (roots.back().index > res->second) {
+                    accepting |= roots.back().accepting;
+                    open |= roots.back().open;
+                    roots.pop_back();
+                }
+                roots.back().accepting |= accepting;
+                roots.back().open |= open;
+                if (roots.back().accepting) {
+                    if (Config.is_set("--verbose"))
+                        std::cout << "Accepting SCC found at vertex " << succ << "\n";
+                    return true;
+                }
+            }
+            else {
+                StateId vertex_id = top.vertex;
+                to_process.pop_back();
+                if (roots.back().index != number[vertex_id])
+                    continue;
+
+                // Vertex is the root of SCC, close it. An SCC which reaches
+                // only expanded vertices keeps its edges in the later passes.
+                bool open = roots.back().open;
+                roots.pop_back();
+                if (!roots.empty())
+                    roots.back().open |= open;
+                StateId w;
+                do {
+                    w = live.back();
+                    live.pop_back();
+                    number[w] = 0;
+                    if (explored_only && !open)
+                        graph.get_vertex_info(w).scc_closed = true;
+                } while (w != vertex_id);
+            }
+        }
+    }
+    return false;
+}
+
+template <class Store, class Hit>
+void Ltl<Store, Hit>::run_owcty(StateId start_vertex) {
+    // Successor generation uses the single evaluator and solver context, so
+    // the product graph is built sequentially. Vertices are the discovery
+    // indices of the database, the queue is FIFO, so they are expanded in
+    // the order of the indices and the index of the front is known.
+    CsrGraph product;
+    std::vector<bool> accepting;
+    std::deque<StateId> to_do = { start_vertex };
+    std::vector<CsrGraph::Index> successor_indices;
+    while (!to_do.empty()) {
+        CsrGraph::Index index = knowns.size() - to_do.size();
+        StateId vertex_id = to_do.front(); to_do.pop_front();
+
+        // New states get consecutive indices in the order of their first
+        // occurrence among the successors
+        CsrGraph::Index next_new = knowns.size();
+        auto successors = generate_successors(vertex_id);
+        successor_indices.clear();
+        for (StateId succ : successors) {
+            CsrGraph::Index succ_index = knowns.index_of(succ);
+            if (succ_index == next_new) {
+                to_do.push_back(succ);
+                next_new++;
+            }
+            successor_indices.push_back(succ_index);
+        }
+        product.add_successors(index, successor_indices);
+        accepting.push_back(is_accepting(vertex_id));
+    }
+
+    unsigned threads = Config.get_long("--threads");
+    Owcty owcty(product, accepting, threads);
+    bool accepting_found = owcty.run(0);
+
+    if (Config.is_set("--statistics")) {
+        std::cout << "States count\n"
+            "------------\n";
+        std::cout << knowns.size() << "\n";
+        knowns.dump_stat(std::cout);
+        std::cout << "OWCTY iterations: " << owcty.iterations() << "\n\n";
+    }
+
+    if (accepting_found)
+        std::cout << "Property violated!\n";
+    else
+        std::cout << "Property holds!\n";
+}
+
+template <class Store, class Hit>
+void Ltl<Store, Hit>::snapshot(SnapshotWriter& w, StateId start_vertex,
+    const OuterDfs& dfs)
+{
+    w.write(std::string(Checkpointer::header()));
+    w.write(std::string("ltl"));
+    w.write(start_vertex);
+    w.write(dfs.stack);
+    w.write(dfs.depth_bound);
+    w.write(dfs.depth_bound_reached);
+    w.write(dfs.continued);
+    w.write(dfs.frontier);
+    w.write(dfs.seeds);
+    knowns.save(w);
+    graph.save(w);
+    Z3cache.save(w);
+    SimplifyCache.save(w);
+}
+
+template <class Store, class Hit>
+StateId Ltl<Store, Hit>::resume(const std::string& filename, OuterDfs& dfs) {
+    std::ifstream in;
+    Checkpointer::open(filename, in);
+    SnapshotReader r(in);
+    if (r.get<std::string>() != Checkpointer::header()
+        || r.get<std::string>() != "ltl")
+        throw CheckpointException(filename + " is not an LTL checkpoint");
+    StateId start_vertex = r.get<StateId>();
+    r.read(dfs.stack);
+    r.read(dfs.depth_bound);
+    r.read(dfs.depth_bound_reached);
+    r.read(dfs.continued);
+    r.read(dfs.frontier);
+    r.read(dfs.seeds);
+    knowns.load(r);
+    graph.load(r);
+    Z3cache.load(r);
+    SimplifyCache.load(r);
+    std::cout << "Resumed from " << filename << ", " << knowns.size()
+        << " states known\n";
+    return start_vertex;
+}
+
 template <class Store, class Hit>
 bool Ltl<Store, Hit>::run_inner_dfs(StateId start_vertex) {
 	if (!graph.exists(start_vertex))
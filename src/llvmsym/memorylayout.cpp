@@ -53,29 +53,74 @@ void MemoryLayout::leave( unsigned tid )
 int MemoryLayout::newSegment( unsigned tid )
 {
     assert( tid < thread_segments.size() );
-    
-    int wanted_sid;
-    if ( thread_segments[tid].empty() ) {
-        if ( tid == 0 )
-            wanted_sid = 2;
-        else
-            wanted_sid = thread_segments[tid-1].back() + 1;
-    } else
-        wanted_sid = thread_segments[tid].back() + 1;
+
+    // The canonical slot is taken only after the stride has changed or a
+    // thread has finished, the numbering is fixed by canonicalSegments then
+    int wanted_sid = canonicalSlot( tid, thread_segments[ tid ].size() );
+    if ( static_cast< size_t >( wanted_sid ) >= segments_to_tid.size() )
+        segments_to_tid.resize( wanted_sid + 1, SEG_FREE );
+    else if ( segments_to_tid[ wanted_sid ] != SEG_FREE ) {
+        wanted_sid = segments_to_tid.size();
+        segments_to_tid.push_back( SEG_FREE );
+    }
+    segments_to_tid[ wanted_sid ] = tid;
 
     assert( wanted_sid > 1 );
-    segments_to_tid.insert( segments_to_tid.begin() + wanted_sid, tid );
-    
     thread_segments[ tid ].emplace_back( wanted_sid );
-    for ( unsigned i = tid+1; i < thread_segments.size(); ++i ) {
-        for ( auto &sid : thread_segments[ i ] )
-            ++sid;
-    }
     ++segments_in_stack[ tid ].back();
 
     return wanted_sid;
 }
 
+std::vector< int > MemoryLayout::canonicalSegments() const
+{
+    std::vector< int > map( segments_to_tid.size(), -1 );
+    map[ 0 ] = 0;
+    map[ 1 ] = 1;
+
+    bool identity = true;
+    unsigned count = 2;
+    for ( size_t tid = 0; tid < thread_segments.size(); ++tid ) {
+        const auto &segments = thread_segments[ tid ];
+        for ( size_t k = 0; k < segments.size(); ++k ) {
+            unsigned slot = canonicalSlot( tid, k );
+            identity = identity && segments[ k ] == slot;
+            map[ segments[ k ] ] = slot;
+            count = std::max( count, slot + 1 );
+        }
+    }
+
+    if ( identity && count == segments_to_tid.size() )
+        map.clear();
+    return map;
+}
+
+void MemoryLayout::remapSegments( const std::vector< int > &map )
+{
+    assert( map.size() == variablesFlags.size() );
+
+    int count = 0;
+    for ( int m : map )
+        count = std::max( count, m + 1 );
+
+    std::vector< std::vector< char > > flags( count );
+    for ( size_t s = 0; s < map.size(); ++s ) {
+        if ( map[ s ] != -1 )
+            flags[ map[ s ] ] = std::move( variablesFlags[ s ] );
+    }
+    variablesFlags = std::move( flags );
+
+    for ( auto &segments : thread_segments )
+        for ( auto &s : segments )
+            s = map[ s ];
+
+    segments_to_tid.assign( count, SEG_FREE );
+    segments_to_tid[ 0 ] = segments_to_tid[ 1 ] = SEG_GLOBAL;
+    for ( size_t tid = 0; tid < thread_segments.size(); ++tid )
+        for ( auto s : thread_segments[ tid ] )
+            segments_to_tid[ s ] = tid;
+}
+
 DataStore::Value MemoryLayout::deref( const llvm::Value *v, int tid, bool prev ) const
 {
     bool is_ptr = v->getType()->isPointerTy();
@@ -103,7 +148,7 @@ DataStore::Value MemoryLayout::deref( const llvm::Value *v, int tid, bool prev )
                 != current_frames[ tid ]->valuemap.end() )
     {
         varId = f->second.id;
-        segId = getLastStackSegmentRange( tid, prev ).first;
+        segId = getFrameSegment( tid, prev );
         assert( segId > 1 );
     } else {
         f = global_valuemap->find( v );
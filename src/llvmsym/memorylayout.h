@@ -51,10 +51,36 @@ class MemoryLayout {
     
     typedef std::map< const llvm::Value*, ValueInfo > ValueMap;
     std::shared_ptr< ValueMap > global_valuemap;
+    // Segment ids are stable slots: a segment keeps its id for its whole
+    // lifetime, so pointers to it never have to be fixed up. The k-th segment
+    // of thread tid gets the canonical slot 2 + k * stride + tid, where the
+    // stride is the number of threads rounded up to a power of two. Calls and
+    // returns in any thread keep the numbering canonical, so do starting
+    // and finishing the last thread unless the stride changes. The per-state
+    // segment table segments_to_tid records the owner of every slot, trailing
+    // free slots are dropped.
     std::vector< std::vector< short unsigned > > thread_segments;
     std::vector< std::vector< short unsigned > > segments_in_stack;
     std::vector< short unsigned > segments_to_tid;
 
+    enum : short unsigned {
+        SEG_GLOBAL = static_cast< short unsigned >( -1 ),
+        SEG_FREE = static_cast< short unsigned >( -2 )
+    };
+
+    unsigned stride() const
+    {
+        unsigned s = 1;
+        while ( s < thread_segments.size() )
+            s *= 2;
+        return s;
+    }
+
+    unsigned canonicalSlot( unsigned tid, size_t position ) const
+    {
+        return 2 + position * stride() + tid;
+    }
+
     std::vector< std::vector< char > > variablesFlags;
     enum {
         F_MULTIVAL = 1 << 0,
@@ -81,8 +107,8 @@ class MemoryLayout {
         segments_in_stack.clear();
         thread_segments.clear();
         segments_to_tid.clear();
-        segments_to_tid.push_back( -1 ); // pointers to globals
-        segments_to_tid.push_back( -1 ); // actual globals
+        segments_to_tid.push_back( SEG_GLOBAL ); // pointers to globals
+        segments_to_tid.push_back( SEG_GLOBAL ); // actual globals
     }
 
     void readData( const char * &mem )
@@ -90,13 +116,11 @@ class MemoryLayout {
         clear();
         blobRead( mem, thread_segments, segments_in_stack, variablesFlags );
         
-        int segments_count = 2;
-        for ( const auto &ts : thread_segments )
-            segments_count += ts.size();
-        segments_to_tid.resize( segments_count );
+        segments_to_tid.resize( variablesFlags.size(), SEG_FREE );
         for ( size_t tid = 0; tid < thread_segments.size(); ++tid ) {
             for ( auto s : thread_segments[ tid ] ) {
                 assert( s > 1 ); // 0th segments + 1th are for globals
+                assert( s < segments_to_tid.size() );
                 segments_to_tid[ s ] = tid;
             }
         }
@@ -111,14 +135,36 @@ class MemoryLayout {
 
     void addSegment( int sid, const std::vector< int > &bws )
     {
-        variablesFlags.emplace( variablesFlags.begin() + sid, bws.size(), F_DEFAULT );
+        if ( static_cast< size_t >( sid ) >= variablesFlags.size() )
+            variablesFlags.resize( sid + 1 );
+        variablesFlags[ sid ].assign( bws.size(), F_DEFAULT );
     }
 
     void eraseSegment( int sid )
     {
-        variablesFlags.erase( variablesFlags.begin() + sid );
+        variablesFlags[ sid ].clear();
+    }
+
+    /**
+     * Number of segment slots, including free slots between used ones
+     */
+    unsigned getSegmentCount() const
+    {
+        return segments_to_tid.size();
     }
 
+    /**
+     * Computes the canonical numbering of segments (see canonicalSlot).
+     * Returns old id -> new id mapping, free slots are mapped to -1. Returns
+     * empty vector if the current numbering is already canonical, which
+     * fails only after the stride has changed or a thread other than the
+     * last one has finished. Only the segments of the threads following it
+     * are moved then.
+     */
+    std::vector< int > canonicalSegments() const;
+
+    void remapSegments( const std::vector< int > &map );
+
     bool isMultival( Value v ) const
     {
         if ( v.type == Value::Type::Constant )
@@ -189,47 +235,51 @@ class MemoryLayout {
         segments_in_stack[ tid ].push_back( 0 );
     }
 
-    std::pair< unsigned, unsigned >
-        getLastStackSegmentRange( unsigned tid, bool prev = false ) const
+    // id of the first segment (registers) of the last (or previous) frame
+    unsigned getFrameSegment( unsigned tid, bool prev = false ) const
     {
         assert( tid < thread_segments.size() );
-        unsigned last, first;
+        const auto &segments = thread_segments[ tid ];
+        const auto &in_stack = segments_in_stack[ tid ];
+        size_t first = segments.size() - in_stack.back();
 
         if ( prev ) {
-            assert( thread_segments[tid].size() > segments_in_stack[tid].back() );
-            last = thread_segments[tid][thread_segments[tid].size() - 1 - segments_in_stack[tid].back()];
-            first = last - segments_in_stack[tid][segments_in_stack[tid].size()-2] + 1;
-        } else {
-            last = thread_segments[tid].back();
-            first = last - segments_in_stack[tid].back() + 1;
+            assert( in_stack.size() > 1 );
+            assert( first >= in_stack[ in_stack.size() - 2 ] );
+            first -= in_stack[ in_stack.size() - 2 ];
         }
-        assert( last <= thread_segments[tid].back() );
-        assert( last >= first );
-        return std::make_pair( first, last + 1 );
+        assert( first < segments.size() );
+        return segments[ first ];
+    }
+
+    std::vector< short unsigned > getLastStackSegments( unsigned tid ) const
+    {
+        assert( tid < thread_segments.size() );
+        const auto &segments = thread_segments[ tid ];
+        assert( segments.size() >= segments_in_stack[ tid ].back() );
+        return std::vector< short unsigned >(
+                segments.end() - segments_in_stack[ tid ].back(), segments.end() );
     }
 
     void dropLastStack( unsigned tid )
     {
         assert( tid < thread_segments.size() );
-        std::pair< unsigned, unsigned > segments_range = getLastStackSegmentRange( tid );
-        auto first = segments_to_tid.begin() + segments_range.first;
-        auto last = segments_to_tid.begin() + segments_range.second;
-        unsigned stack_width = last - first;
-        segments_to_tid.erase( first, last );
-        for ( auto &sids : thread_segments ) {
-            for ( auto &s : sids ) {
-                if ( s >= segments_range.second )
-                    s -= stack_width;
-            }
-        }
-        assert( thread_segments[ tid ].size() >= stack_width );
-        thread_segments[ tid ].erase( thread_segments[ tid ].end() - stack_width, thread_segments[ tid ].end() );
-        if ( thread_segments[ tid ].empty() ) {
+        auto &segments = thread_segments[ tid ];
+        unsigned stack_width = segments_in_stack[ tid ].back();
+        assert( segments.size() >= stack_width );
+        for ( auto it = segments.end() - stack_width; it != segments.end(); ++it )
+            segments_to_tid[ *it ] = SEG_FREE;
+        segments.erase( segments.end() - stack_width, segments.end() );
+        while ( segments_to_tid.back() == SEG_FREE )
+            segments_to_tid.pop_back();
+        if ( variablesFlags.size() > segments_to_tid.size() )
+            variablesFlags.resize( segments_to_tid.size() );
+        if ( segments.empty() ) {
             assert( segments_in_stack[ tid ].size() == 1 );
             thread_segments.erase( thread_segments.begin() + tid );
             segments_in_stack.erase( segments_in_stack.begin() + tid );
             for ( auto &t : segments_to_tid )
-                if ( t > tid )
+                if ( t != SEG_GLOBAL && t != SEG_FREE && t > tid )
                     --t;
         } else {
             segments_in_stack[ tid ].pop_back();
@@ -13,15 +13,43 @@ Options:
   --version               Show version.
   --cheapsimplify         Use only cheap simplificatin methods.
   --dontsimplify          Disable simplification.
+  --disablegc             Disable garbage collection of constraints over dead variables.
+  --projection            Eliminate quantifiers of stored states for subseteq, slow
+                          for wide bit-vectors.
+  --disableintervals      Do not decide queries by intervals and known bits.
   --disabletimeout        Disable timeout for Z3.
+  --concretize-below=<n>  Enumerate nondeterministic inputs with at most <n> values
+                          explicitly instead of making them symbolic [default: 0].
   --iterative             Enables iterative depth search.
+  --owcty                 Use parallel OWCTY instead of nested DFS for LTL.
+  --scc                   Use single pass SCC-based LTL check (no nested DFS).
+  --threads=<n>           Number of threads for OWCTY, 0 for all cores [default: 0].
   -p --partialstore       Use partial SMT store (better caching).
   --testvalidity          When using partial store, compare results with full store.
   -c --enablecaching      Enable caching for Z3 formulas.
+  --simplify-cache=<n>    Memoize at most <n> simplified formulas, 0 for no limit
+                          [default: 65536].
   --q3bsimplify           Enable simplifications using Q3B SMT Solver
   -s --statistics         Enable output of statistics.
+  --stats-json=<file>     Write statistics to <file> in JSON format.
   --space_output=<file>   Outputs state space to <file> in dot format.
+  --space_stream=<file>   Streams state space to <file> in binary format during
+                          exploration (see scripts/convert_space.py).
+  --space_labels          Include state descriptions in the streamed state space.
+  --capture-states=<file>  Save all generated states to <file> for symdivine_bench.
+  --no-trace              Do not keep parent pointers for counterexample traces.
+  --witness=<file>        Write SV-COMP witness in GraphML to <file>.
+  --witness-program=<file>  Source file the witness refers to.
+  --witness-arch=<arch>   Architecture of the witness [default: 32bit].
   --bound=<depth>         Limits depth exploration to given bound.
+  --spot                  Translate LTL to BA by ltl2tgba instead of built-in translator.
+  --ltl-cache=<dir>       Cache translated Buchi automata in <dir>.
+  --mem-limit=<MB>        Spill stored symbolic states to disk above <MB> MB. The
+                          limit counts the state database only, explicit parts,
+                          formulas and the LTL product graph stay in memory.
+  --checkpoint=<file>     Periodically save the exploration state to <file>.
+  --checkpoint-interval=<s>  Seconds between checkpoints [default: 600].
+  --resume=<file>         Resume exploration from checkpoint <file>.
   -v --verbose            Enable verbose mode.
   -w --vverbose           Enable extended verbose mode.
 )";
@@ -22,3 +22,20 @@ std::ostream& operator<<( std::ostream &o, const Statistics &s )
     return o;
 }
 
+
+void Statistics::dumpJson( std::ostream &o )
+{
+    o << "{";
+    bool first = true;
+    for ( const auto& counter : get().data ) {
+        o << ( first ? "" : "," ) << "\n    \"";
+        for ( char c : counter.first ) {
+            if ( c == '"' || c == '\\' )
+                o << '\\';
+            o << c;
+        }
+        o << "\": " << counter.second;
+        first = false;
+    }
+    o << "\n  }";
+}
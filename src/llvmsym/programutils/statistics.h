@@ -29,6 +29,11 @@ class Statistics {
         return get().data[ name ];
     }
 
+    /**
+     * Writes all counters as a JSON object
+     */
+    static void dumpJson( std::ostream &o );
+
     friend std::ostream& operator<<( std::ostream &o, const Statistics &s );
 
     protected:
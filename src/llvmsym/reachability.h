@@ -1,6 +1,6 @@
 #pragma once
 #include <string>
-#include <queue>
+#include <deque>
 
 #include "evaluator.h"
 #include "datastore.h"
@@ -8,7 +8,12 @@
 #include "smtdatastore.h"
 #include "smtdatastore_partial.h"
 #include "programutils/config.h"
-#include "../toolkit/graph.h"
+#include "../toolkit/csr_graph.h"
+#include "../toolkit/z3cache.h"
+#include "../toolkit/checkpoint.h"
+#include "../toolkit/space_writer.h"
+#include "../toolkit/witness.h"
+#include "../toolkit/state_corpus.h"
 
 using namespace llvm_sym; // This is weird, can't compile with direct usage of namespace
 
@@ -21,11 +26,52 @@ public:
     Reachability(const std::string& model);
     void run();
     void output_state_space(const std::string& filename);
+    size_t state_count() {
+        return knowns.size();
+    }
 private:
     Evaluator<Store> eval; // Evaluator for the bitcode
-    Database<Blob, Store, LinearCandidate<Store, Hit>, blobHashExplicitPart,
-        blobEqualExplicitPart> knowns;
-    Graph<StateId> graph;
+    Database<Blob, Store, LinearCandidate<Store, Hit>> knowns;
+    CsrGraph graph; // Kept only for --space_output, indexed by discovery order
+    bool keep_graph;
+    Checkpointer checkpoint;
+    SpaceWriter space; // Streamed state space (--space_stream)
+    StateCorpusWriter capture; // Captured states for symdivine_bench
+
+    /**
+     * Link to the predecessor of a state for counterexample traces. States
+     * are numbered in the order of discovery in the database, which is also
+     * the order of expansion. The successor number allows to replay the step.
+     */
+    struct Parent {
+        uint32_t index;
+        uint32_t successor;
+    };
+    std::vector<Parent> parents; // Empty with --no-trace
+    bool keep_trace;
+    StateId initial_id;
+
+    /**
+     * Replays the path to given successor of given state and prints it
+     * together with the values of inputs leading to the last state. The path
+     * is also written to the witness.
+     */
+    void print_trace(uint32_t index, uint32_t successor, WitnessWriter& witness);
+
+    /**
+     * Returns description of the state loaded in the evaluator
+     */
+    std::string state_label(const StateId& vertex_id);
+
+    /**
+     * Serializes the exploration state with given queue
+     */
+    void snapshot(SnapshotWriter& w, const std::deque<StateId>& to_do);
+
+    /**
+     * Restores the exploration state from given checkpoint file
+     */
+    void resume(const std::string& filename, std::deque<StateId>& to_do);
 };
 
 #include "reachability.tpp"
\ No newline at end of file
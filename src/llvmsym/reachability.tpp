@@ -3,32 +3,67 @@
 #include <iostream>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <type_traits>
 
 template <class Store, class Hit>
 Reachability<Store, Hit>::Reachability(const std::string& model_name)
-    : eval(std::make_shared<BitCode>(model_name))
-{}
+    : eval(std::make_shared<BitCode>(model_name)),
+      checkpoint(Config.is_set("--checkpoint") ? Config.get_string("--checkpoint") : "",
+          Config.get_long("--checkpoint-interval")),
+      space(Config.is_set("--space_stream") ? Config.get_string("--space_stream") : "",
+          "reachability"),
+      capture(Config.is_set("--capture-states") ? Config.get_string("--capture-states") : "",
+          std::is_same<Store, SMTStorePartial>::value ? "partial" : "full"),
+      keep_graph(Config.is_set("--space_output")),
+      keep_trace(!Config.is_set("--no-trace"))
+{
+    if (Config.is_set("--mem-limit"))
+        knowns.set_mem_limit(Config.get_long("--mem-limit") << 20);
+}
 
 template <class Store, class Hit>
 void Reachability<Store, Hit>::run() {
     try {
-        std::queue<StateId> to_do;
+        std::deque<StateId> to_do;
 
-        Blob initial(eval.getSize(), eval.getExplicitSize());
-        eval.write(initial.getExpl());
+        if (Config.is_set("--resume"))
+            resume(Config.get_string("--resume"), to_do);
+        else {
+            Blob initial(eval.getSize(), eval.getExplicitSize());
+            eval.write(initial.getExpl());
 
-        StateId initial_id = knowns.insert(initial);
-        graph.add_vertex(initial_id);
-        to_do.push(initial_id);
+            initial_id = knowns.insert(initial, eval.getExplicitChunks());
+            if (keep_trace)
+                parents.push_back({ 0, 0 });
+            to_do.push_back(initial_id);
+        }
 
         bool error_found = false;
+        uint32_t error_index = 0, error_successor = 0;
         while (!to_do.empty() && !error_found) {
-            StateId vertex = to_do.front(); to_do.pop();
+            if (checkpoint.due()) {
+                // The writer thread must not run during the fork
+                space.suspend();
+                checkpoint.write([&](SnapshotWriter& w) { snapshot(w, to_do); });
+                space.resume();
+            }
+
+            // The queue is FIFO, so the discovery index of its front is known
+            uint32_t index = knowns.size() - to_do.size();
+            StateId vertex = to_do.front(); to_do.pop_front();
             Blob b = knowns.getState(vertex);
+            uint32_t successor = 0;
 
             std::vector<StateId> successors;
+            std::vector<CsrGraph::Index> successor_indices;
 
             eval.read(b.getExpl());
+            if (space.enabled()) {
+                space.vertex(vertex.exp_id, vertex.sym_id, 0,
+                    Config.is_set("--space_labels") ? state_label(vertex) : "");
+            }
+
             eval.advance([&]() {
                 Blob newSucc(eval.getSize(), eval.getExplicitSize());
                 eval.write(newSucc.getExpl());
@@ -37,10 +72,16 @@ void Reachability<Store, Hit>::run() {
                     std::cout << "Error state:\n";
                     eval.dump();
                     std::cout << "is reachable." << std::endl;
+                    if (!error_found) {
+                        error_index = index;
+                        error_successor = successor;
+                    }
                     error_found = true;
                 }
 
-                auto value = knowns.insertCheck(newSucc);
+                auto chunks = eval.getExplicitChunks();
+                capture.state(newSucc, chunks);
+                auto value = knowns.insertCheck(newSucc, chunks);
                 if (value.first) {
                     if (Config.is_set("--verbose") || Config.is_set("--vverbose")) {
                         static int succs_total = 0;
@@ -48,21 +89,40 @@ void Reachability<Store, Hit>::run() {
                         /*std::cout << "New id: <" << value.second.exp_id
                             << ", " << value.second.sym_id << ">\n";*/
                     }
-                    to_do.push(value.second);
-                    
+                    to_do.push_back(value.second);
+                    if (keep_trace)
+                        parents.push_back({ index, successor });
                 }
                 successors.push_back(value.second);
+                if (keep_graph)
+                    successor_indices.push_back(value.first
+                        ? knowns.size() - 1 : knowns.index_of(value.second));
+                successor++;
             });
-            graph.add_successors(vertex, successors);
+            if (keep_graph)
+                graph.add_successors(index, successor_indices);
+            for (const auto& succ : successors)
+                space.edge(vertex.exp_id, vertex.sym_id, succ.exp_id, succ.sym_id);
         }
+        space.close();
 
+        WitnessWriter witness(
+            Config.is_set("--witness") ? Config.get_string("--witness") : "",
+            error_found,
+            Config.is_set("--witness-program") ? Config.get_string("--witness-program") : "",
+            Config.get_string("--witness-arch"));
         if (!error_found)
             std::cout << "Safe." << std::endl;
+        else if (keep_trace)
+            print_trace(error_index, error_successor, witness);
+        witness.close();
 
         if (Config.is_set("--statistics")) {
             std::cout << "States count\n"
                          "------------\n";
-            std::cout << knowns.size() << "\n\n";
+            std::cout << knowns.size() << "\n";
+            knowns.dump_stat(std::cout);
+            std::cout << "\n";
         }
     }
     catch (std::exception& e) {
@@ -73,14 +133,116 @@ void Reachability<Store, Hit>::run() {
     }
 }
 
+template <class Store, class Hit>
+void Reachability<Store, Hit>::print_trace(uint32_t index, uint32_t successor,
+    WitnessWriter& witness)
+{
+    std::vector<uint32_t> steps = { successor };
+    for (; index != 0; index = parents[index].index)
+        steps.push_back(parents[index].successor);
+    std::reverse(steps.begin(), steps.end());
+
+    std::cout << "\nCounterexample trace:\n";
+    Blob state = knowns.getState(initial_id);
+    for (size_t step = 0; step != steps.size(); step++) {
+        eval.read(state.getExpl());
+        const Control control = eval.getState()->control;
+        std::cout << "Step " << step << ":\n" << control;
+        std::vector<unsigned> lines;
+        for (size_t tid = 0; tid != control.threadCount(); tid++)
+            lines.push_back(eval.getSourceLine(tid));
+
+        uint32_t n = 0;
+        Blob next;
+        eval.advance([&]() {
+            if (n++ != steps[step])
+                return;
+            next = Blob(eval.getSize(), eval.getExplicitSize());
+            eval.write(next.getExpl());
+        });
+        if (n <= steps[step])
+            throw std::runtime_error("Cannot replay counterexample trace");
+        state = next;
+
+        // The step was performed by the first thread whose context changed
+        eval.read(state.getExpl());
+        const auto& context = eval.getState()->control.context;
+        size_t tid = 0;
+        while (tid < control.context.size() && tid < context.size()
+            && context[tid] == control.context[tid])
+            tid++;
+        witness.step(tid < lines.size() ? lines[tid] : 0, tid);
+    }
+
+    std::cout << "Step " << steps.size() << " (error):\n";
+    eval.dump();
+    std::cout << "\nInput values:\n";
+    eval.getState()->data.dump_model(std::cout);
+}
+
+template <class Store, class Hit>
+std::string Reachability<Store, Hit>::state_label(const StateId& vertex_id) {
+    std::stringstream s;
+    auto* state = eval.getState();
+    s << "<" << vertex_id.exp_id << ", " << vertex_id.sym_id << ">\n"
+      << state->control << "\n" << state->explicitData << "\n" << state->data;
+    return s.str();
+}
+
+template <class Store, class Hit>
+void Reachability<Store, Hit>::snapshot(SnapshotWriter& w,
+    const std::deque<StateId>& to_do)
+{
+    w.write(std::string(Checkpointer::header()));
+    w.write(std::string("reachability"));
+    knowns.save(w);
+    graph.save(w);
+    w.write(std::vector<StateId>(to_do.begin(), to_do.end()));
+    w.write(parents);
+    w.write(initial_id);
+    Z3cache.save(w);
+    SimplifyCache.save(w);
+}
+
+template <class Store, class Hit>
+void Reachability<Store, Hit>::resume(const std::string& filename,
+    std::deque<StateId>& to_do)
+{
+    std::ifstream in;
+    Checkpointer::open(filename, in);
+    SnapshotReader r(in);
+    if (r.get<std::string>() != Checkpointer::header()
+        || r.get<std::string>() != "reachability")
+        throw CheckpointException(filename + " is not a reachability checkpoint");
+    knowns.load(r);
+    graph.load(r);
+    auto queue = r.get<std::vector<StateId>>();
+    to_do.assign(queue.begin(), queue.end());
+    r.read(parents);
+    r.read(initial_id);
+    // Traces are available only if the checkpointed run kept them
+    if (parents.empty())
+        keep_trace = false;
+    if (!keep_trace)
+        parents.clear();
+    Z3cache.load(r);
+    SimplifyCache.load(r);
+    std::cout << "Resumed from " << filename << ", " << knowns.size()
+        << " states known\n";
+}
+
 template <class Store, class Hit>
 void Reachability<Store, Hit>::output_state_space(const std::string& filename) {
-    auto id_format = [](const StateId& id) {
+    const std::vector<StateId> ids = knowns.ids();
+
+    auto id_format = [&ids](CsrGraph::Index i) {
+        const StateId& id = ids[i];
         return std::string("E") + std::to_string(id.exp_id) + "S" +
             std::to_string(id.sym_id);
     };
 
-    auto label_format = [this](const StateId& vertex_id) {
+    auto label_format = [this, &ids](CsrGraph::Index i) {
+        const StateId& vertex_id = ids[i];
         std::string ba_state;
         std::string control;
         try {
@@ -100,10 +262,10 @@ void Reachability<Store, Hit>::output_state_space(const std::string& filename) {
             + control;
     };
 
-    auto style_format = [this](const StateId& vertex_id)->std::string {
+    auto style_format = [](CsrGraph::Index)->std::string {
         return "style=\"filled\" fillcolor=\"#FFC65D\"";
     };
 
     std::ofstream o(filename);
-    graph.to_dot(o, id_format, label_format, style_format);
+    graph.to_dot(o, ids.size(), id_format, label_format, style_format);
 }
\ No newline at end of file
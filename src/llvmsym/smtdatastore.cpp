@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <unordered_set>
 #include <llvmsym/smtdatastore.h>
 #include <toolkit/z3cache.h>
 
@@ -6,6 +7,13 @@ namespace llvm_sym {
 
     unsigned SMTStore::unknown_instances = 0;
 
+    namespace {
+        // Hashes of the projected constraints whose elimination failed, a
+        // collision only makes subseteq use the quantified query
+        std::unordered_set< size_t > failed_projections;
+        const size_t max_failed_projections = 1 << 20;
+    }
+
     std::ostream & operator<<(std::ostream & o, const SMTStore &v) {
         o << "data:\n";
 
@@ -25,6 +33,8 @@ namespace llvm_sym {
             static bool simplify = Config.is_set("--q3bsimplify");
             if (path_condition.size() == 0)
                 return false;
+            if (abstract_empty(definitions, path_condition))
+                return true;
 
             z3::context c;
             z3::expr pc = c.bool_val(true);
@@ -57,7 +67,6 @@ namespace llvm_sym {
     bool SMTStore::subseteq(const SMTStore &b, const SMTStore &a, bool timeout,
         bool is_caching_enabled)
     {
-        static bool simplify = Config.is_set("--q3bsimplify");
         ++Statistics::getCounter(SUBSETEQ_CALLS);
         if (a.definitions == b.definitions) {
             bool equal_syntax = a.path_condition.size() == b.path_condition.size();
@@ -93,6 +102,69 @@ namespace llvm_sym {
         if (to_compare.empty())
             return true;
 
+        if (abstract_not_subseteq(a.definitions, a.path_condition,
+                b.definitions, b.path_condition, to_compare))
+            return false;
+
+        return query_subseteq(b, &a, nullptr, to_compare, timeout, is_caching_enabled);
+    }
+
+    bool SMTStore::subseteq(const SMTStore &b, const Packed &a, bool timeout,
+        bool is_caching_enabled)
+    {
+        ++Statistics::getCounter(SUBSETEQ_CALLS);
+        if (a.same_constraints(b)) {
+            ++Statistics::getCounter(SUBSETEQ_SYNTAX_EQUAL);
+            return true;
+        }
+
+        std::map< Formula::Ident, Formula::Ident > to_compare;
+        for (unsigned s = 0; s < a.generations.size(); ++s) {
+            assert(a.generations[s].size() == b.generations[s].size());
+            for (unsigned offset = 0; offset < a.generations[s].size(); ++offset) {
+                Value var;
+                var.type = Value::Type::Variable;
+                var.variable.segmentId = s;
+                var.variable.offset = offset;
+
+                Formula::Ident a_atom = a.build_item(var);
+                Formula::Ident b_atom = b.build_item(var);
+
+                if (!a.depends_on(a_atom) && !b.depends_on(var))
+                    continue;
+
+                to_compare.insert(std::make_pair(a_atom, b_atom));
+            }
+        }
+
+        if (to_compare.empty())
+            return true;
+
+        std::vector< AbstractEnv::DefinitionRef > a_defs;
+        std::vector< const Formula* > a_pcs;
+        a.constraint_refs(a_defs, a_pcs);
+        if (abstract_not_subseteq(a_defs, a_pcs, b.definitions, b.path_condition,
+                to_compare))
+            return false;
+
+        return query_subseteq(b, nullptr, &a, to_compare, timeout, is_caching_enabled);
+    }
+
+    bool SMTStore::query_subseteq(const SMTStore &b, const SMTStore *a,
+        const Packed *packed_a,
+        const std::map< Formula::Ident, Formula::Ident > &to_compare,
+        bool timeout, bool is_caching_enabled)
+    {
+        static bool simplify = Config.is_set("--q3bsimplify");
+        std::unique_ptr< SMTStore > unpacked;
+        auto get_a = [&]() -> const SMTStore& {
+            if (!a) {
+                unpacked.reset(new SMTStore(*packed_a));
+                a = unpacked.get();
+            }
+            return *a;
+        };
+
         // pc_b && foreach(a).(!pc_a || a!=b)
         // (sat iff not _b_ subseteq _a_)
         z3::context c;
@@ -113,12 +185,12 @@ namespace llvm_sym {
             StopWatch s;
             s.start();
 
-            std::copy(a.path_condition.begin(), a.path_condition.end(),
+            std::copy(get_a().path_condition.begin(), get_a().path_condition.end(),
                 std::back_inserter(formula.pc_a));
             std::copy(b.path_condition.begin(), b.path_condition.end(),
                 std::back_inserter(formula.pc_b));
 
-            for (const Definition &def : a.definitions)
+            for (const Definition &def : get_a().definitions)
                 formula.pc_a.push_back(def.to_formula());
 
             for (const Definition &def : b.definitions)
@@ -144,42 +216,66 @@ namespace llvm_sym {
         StopWatch solving_time;
         solving_time.start();
 
-        z3::expr pc_a = c.bool_val(true);
-        for (const auto &pc : a.path_condition)
-            pc_a = pc_a && toz3(pc, 'a', c);
+        std::vector< Formula::Ident > a_atoms, b_atoms;
+        for (const auto &vars : to_compare) {
+            a_atoms.push_back(vars.first);
+            b_atoms.push_back(vars.second);
+        }
+        QuerySide side_b = query_side(b.definitions, b.path_condition, b_atoms);
+
         z3::expr pc_b = c.bool_val(true);
-        for (const auto &pc : b.path_condition)
-            pc_b = pc_b && toz3(pc, 'b', c);
+        for (const auto &f : side_b.constraints)
+            pc_b = pc_b && toz3(f, 'b', c);
+
+        z3::check_result ret = z3::unknown;
+        const Projection *projection = nullptr;
+        if (a && a->projection)
+            projection = &a->get_projection();
+        else if (!a && packed_a->projection)
+            projection = &packed_a->get_projection();
+        if (projection && projection->valid) {
+            // pc_b && a=b && !proj_a(a) (quantifier-free)
+            ++Statistics::getCounter(SUBSETEQ_PROJECTED);
+            z3::expr query = pc_b && !toz3(projection->formula, 'a', c);
+            for (size_t i = 0; i < a_atoms.size(); ++i) {
+                query = query && toz3(Formula::buildIdentifier(a_atoms[i]), 'a', c)
+                    == toz3(side_b.atoms[i], 'b', c);
+            }
+            ret = solve_query_qf(s, query);
+        }
+        else {
+            QuerySide side_a = query_side(get_a().definitions, get_a().path_condition, a_atoms);
 
-        for (const Definition &def : a.definitions)
-            pc_a = pc_a && toz3(def.to_formula(), 'a', c);
-        for (const Definition &def : b.definitions)
-            pc_b = pc_b && toz3(def.to_formula(), 'b', c);
+            z3::expr pc_a = c.bool_val(true);
+            for (const auto &f : side_a.constraints)
+                pc_a = pc_a && toz3(f, 'a', c);
 
-        z3::expr distinct = c.bool_val(false);
+            z3::expr distinct = c.bool_val(false);
 
-        for (const auto &vars : to_compare) {
-            z3::expr a_expr = toz3(Formula::buildIdentifier(vars.first), 'a', c);
-            z3::expr b_expr = toz3(Formula::buildIdentifier(vars.second), 'b', c);
+            for (size_t i = 0; i < side_a.atoms.size(); ++i) {
+                z3::expr a_expr = toz3(side_a.atoms[i], 'a', c);
+                z3::expr b_expr = toz3(side_b.atoms[i], 'b', c);
 
-            distinct = distinct || (a_expr != b_expr);
-        }
+                distinct = distinct || (a_expr != b_expr);
+            }
 
-        std::vector< z3::expr > a_all_vars;
+            // Compared variables unconstrained in a are quantified too
+            std::vector< z3::expr > a_all_vars;
 
-        for (const auto &var : a.collect_variables()) {
-            a_all_vars.push_back(toz3(Formula::buildIdentifier(var), 'a', c));
-        }
+            for (const auto &var : side_a.variables()) {
+                a_all_vars.push_back(toz3(Formula::buildIdentifier(var), 'a', c));
+            }
 
-        z3::expr not_witness = !pc_a || distinct;
-        z3::expr query = pc_b && forall(a_all_vars, not_witness);
+            z3::expr not_witness = !pc_a || distinct;
+            z3::expr query = pc_b && (a_all_vars.empty() ? not_witness : forall(a_all_vars, not_witness));
 
-        if (simplify) {
-            ExprSimplifier simp(c, true);
-            query = simp.Simplify(query);
-        }
+            if (simplify) {
+                ExprSimplifier simp(c, true);
+                query = simp.Simplify(query);
+            }
 
-        z3::check_result ret = solve_query_q(s, query);
+            ret = solve_query_q(s, query);
+        }
 
         if (ret == z3::unknown) {
             ++unknown_instances;
@@ -210,5 +306,64 @@ namespace llvm_sym {
         return real_result;
     }
 
+    const SMTStore::Projection& SMTStore::get_projection() const {
+        Projection &p = *projection;
+        if (p.computed)
+            return p;
+        p.computed = true;
+        ++Statistics::getCounter(PROJECTIONS);
+
+        std::vector< Formula::Ident > atoms;
+        for (unsigned s = 0; s < generations.size(); ++s) {
+            for (unsigned offset = 0; offset < generations[s].size(); ++offset) {
+                Value var;
+                var.type = Value::Type::Variable;
+                var.variable.segmentId = s;
+                var.variable.offset = offset;
+                if (depends_on(var))
+                    atoms.push_back(build_item(var));
+            }
+        }
+
+        // exists hidden. constraints && atoms == their inlined definitions
+        QuerySide side = query_side(definitions, path_condition, atoms);
+        Formula body;
+        for (const auto &f : side.constraints)
+            body = body && f;
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            if (side.atoms[i]._rpn != Formula::buildIdentifier(atoms[i])._rpn)
+                body = body && (Formula::buildIdentifier(atoms[i]) == side.atoms[i]);
+        }
+
+        std::sort(atoms.begin(), atoms.end());
+        z3::context c;
+        std::vector< z3::expr > hidden;
+        for (const auto &var : side.variables()) {
+            if (!std::binary_search(atoms.begin(), atoms.end(), var))
+                hidden.push_back(toz3(Formula::buildIdentifier(var), 'a', c));
+        }
+
+        if (hidden.empty()) {
+            p.formula = body;
+            p.valid = true;
+            return p;
+        }
+
+        size_t hash = std::hash< Formula >()(body);
+        if (failed_projections.count(hash)) {
+            ++Statistics::getCounter(PROJECTIONS_SKIPPED);
+            return p;
+        }
+        p.valid = eliminate_quantifiers(exists(hidden, toz3(body, 'a', c)),
+            p.formula, projection_timeout, projection_growth * body._rpn.size());
+        if (!p.valid) {
+            ++Statistics::getCounter(PROJECTIONS_FAILED);
+            if (failed_projections.size() == max_failed_projections)
+                failed_projections.clear();
+            failed_projections.insert(hash);
+        }
+        return p;
+    }
+
 }
 
@@ -5,7 +5,9 @@
 #include <llvmsym/formula/z3.h>
 #include <llvmsym/programutils/statistics.h>
 #include <llvmsym/programutils/config.h>
+#include <toolkit/formula_pool.h>
 #include <vector>
+#include <memory>
 #include <q3b/ExprSimplifier.h>
 
 
@@ -18,10 +20,233 @@ namespace llvm_sym {
         std::vector< std::vector< char > > bitWidths;
 
         std::vector< Formula > path_condition;
+        size_t simplified_pc = 0; // Leading conjuncts simplified already
         std::vector< Definition > definitions;
         int fst_unused_id = 0;
         static unsigned unknown_instances;
 
+        /**
+         * Existential projection of the constraints onto the variables the
+         * state depends on. It turns subseteq against the state into a
+         * quantifier-free query. It is computed only with --projection, the
+         * elimination enumerates values of the bit-vectors, so it is given
+         * its own small budget and its result has a bounded size.
+         */
+        struct Projection {
+            bool computed = false;
+            bool valid = false; // The quantifiers were eliminated
+            Formula formula;
+        };
+        // Computed lazily for the stored states only (they share it with
+        // their packed form), null for the others
+        std::shared_ptr< Projection > projection;
+
+        /**
+         * Compact form of the store kept in the state database. Formulas are
+         * replaced by references into the global formula pool. Subseteq reads
+         * the formulas of a packed state directly from the pool, the state is
+         * unpacked only for the quantified query. The packed state owns its
+         * references into the pool, so it can be moved but not copied.
+         */
+        struct Packed {
+            std::vector< short unsigned > segments_mapping;
+            std::vector< std::vector< short unsigned > > generations;
+            std::vector< std::vector< char > > bitWidths;
+            std::vector< std::pair< Formula::Ident, FormulaPool::Ref > > definitions;
+            std::vector< FormulaPool::Ref > path_condition;
+            size_t simplified_pc;
+            int fst_unused_id;
+            std::shared_ptr< Projection > projection;
+
+            explicit Packed(const SMTStore& s)
+                : segments_mapping(s.segments_mapping), generations(s.generations),
+                  bitWidths(s.bitWidths), simplified_pc(s.simplified_pc),
+                  fst_unused_id(s.fst_unused_id)
+            {
+                static bool enabled = Config.is_set("--projection");
+                if (enabled)
+                    projection = std::make_shared< Projection >();
+                definitions.reserve(s.definitions.size());
+                for (const Definition& d : s.definitions)
+                    definitions.emplace_back(d.symbol, Formulas.intern(d.def));
+                path_condition.reserve(s.path_condition.size());
+                for (const Formula& pc : s.path_condition)
+                    path_condition.push_back(Formulas.intern(pc));
+            }
+
+            Packed(const Packed&) = delete;
+            Packed& operator=(const Packed&) = delete;
+
+            Packed(Packed&& o) noexcept
+                : segments_mapping(std::move(o.segments_mapping)),
+                  generations(std::move(o.generations)),
+                  bitWidths(std::move(o.bitWidths)),
+                  definitions(std::move(o.definitions)),
+                  path_condition(std::move(o.path_condition)),
+                  simplified_pc(o.simplified_pc), fst_unused_id(o.fst_unused_id),
+                  projection(std::move(o.projection))
+            {
+                o.definitions.clear();
+                o.path_condition.clear();
+            }
+
+            Packed& operator=(Packed&& o) noexcept {
+                segments_mapping.swap(o.segments_mapping);
+                generations.swap(o.generations);
+                bitWidths.swap(o.bitWidths);
+                definitions.swap(o.definitions);
+                path_condition.swap(o.path_condition);
+                std::swap(simplified_pc, o.simplified_pc);
+                std::swap(fst_unused_id, o.fst_unused_id);
+                projection.swap(o.projection);
+                return *this;
+            }
+
+            ~Packed() {
+                for (const auto& d : definitions)
+                    Formulas.release(d.second);
+                for (FormulaPool::Ref r : path_condition)
+                    Formulas.release(r);
+            }
+
+            bool operator==(const Packed& o) const {
+                return fst_unused_id == o.fst_unused_id
+                    && path_condition == o.path_condition
+                    && definitions == o.definitions
+                    && segments_mapping == o.segments_mapping
+                    && generations == o.generations
+                    && bitWidths == o.bitWidths;
+            }
+
+            Formula::Ident build_item(Value val) const {
+                assert(val.type == Value::Type::Variable);
+                return Formula::Ident(
+                            segments_mapping[val.variable.segmentId],
+                            val.variable.offset,
+                            generations[val.variable.segmentId][val.variable.offset],
+                            bitWidths[val.variable.segmentId][val.variable.offset]
+                            );
+            }
+
+            bool depends_on(const Formula::Ident& id) const {
+                for (const auto& d : definitions) {
+                    if (d.first == id || Formulas.get(d.second).depends_on(id.seg, id.off, id.gen))
+                        return true;
+                }
+                for (FormulaPool::Ref r : path_condition) {
+                    if (Formulas.get(r).depends_on(id.seg, id.off, id.gen))
+                        return true;
+                }
+                return false;
+            }
+
+            /**
+             * Syntactic equality of the constraints with the ones of s
+             */
+            bool same_constraints(const SMTStore& s) const {
+                if (definitions.size() != s.definitions.size()
+                    || path_condition.size() != s.path_condition.size())
+                    return false;
+                for (size_t i = 0; i != definitions.size(); ++i) {
+                    if (definitions[i].first != s.definitions[i].symbol
+                        || Formulas.get(definitions[i].second)._rpn != s.definitions[i].def._rpn)
+                        return false;
+                }
+                for (size_t i = 0; i != path_condition.size(); ++i) {
+                    if (Formulas.get(path_condition[i])._rpn != s.path_condition[i]._rpn)
+                        return false;
+                }
+                return true;
+            }
+
+            /**
+             * References to the constraints for AbstractEnv::assume, they are
+             * valid until a formula is added to the pool
+             */
+            void constraint_refs(std::vector< AbstractEnv::DefinitionRef >& defs,
+                std::vector< const Formula* >& pcs) const
+            {
+                for (const auto& d : definitions)
+                    defs.emplace_back(d.first, &Formulas.get(d.second));
+                for (FormulaPool::Ref r : path_condition)
+                    pcs.push_back(&Formulas.get(r));
+            }
+
+            /**
+             * See SMTStore::get_projection, the state is unpacked only for
+             * computing it
+             */
+            const Projection& get_projection() const {
+                if (!projection->computed)
+                    SMTStore(*this).get_projection();
+                return *projection;
+            }
+
+            /**
+             * Approximate memory used by the packed state, the formulas are
+             * accounted in the pool
+             */
+            size_t memory() const {
+                size_t size = sizeof(Packed)
+                    + segments_mapping.capacity() * sizeof(short unsigned)
+                    + generations.capacity() * sizeof(generations[0])
+                    + bitWidths.capacity() * sizeof(bitWidths[0])
+                    + definitions.capacity() * sizeof(definitions[0])
+                    + path_condition.capacity() * sizeof(FormulaPool::Ref);
+                for (const auto& g : generations)
+                    size += g.capacity() * sizeof(short unsigned);
+                for (const auto& b : bitWidths)
+                    size += b.capacity();
+                if (projection && projection->valid)
+                    size += projection->formula._rpn.capacity() * sizeof(Formula::Item);
+                return size;
+            }
+
+            // The same serialization as of the unpacked store
+            size_t getSize() const {
+                size_t size = representation_size(segments_mapping, generations, bitWidths, fst_unused_id);
+                size += sizeof(size_t);
+                for (const auto& d : definitions) {
+                    size += representation_size(d.first);
+                    size += representation_size(Formulas.get(d.second)._rpn);
+                }
+                size += sizeof(size_t);
+                for (FormulaPool::Ref r : path_condition)
+                    size += representation_size(Formulas.get(r)._rpn);
+                size += sizeof(size_t);
+                return size;
+            }
+
+            void writeData(char * &mem) const {
+                blobWrite(mem, segments_mapping, generations, bitWidths, fst_unused_id);
+
+                blobWrite(mem, definitions.size());
+                for (const auto& d : definitions) {
+                    blobWrite(mem, d.first);
+                    blobWrite(mem, Formulas.get(d.second)._rpn);
+                }
+                blobWrite(mem, path_condition.size());
+                for (FormulaPool::Ref r : path_condition)
+                    blobWrite(mem, Formulas.get(r)._rpn);
+                blobWrite(mem, simplified_pc);
+            }
+        };
+
+        SMTStore() = default;
+
+        explicit SMTStore(const Packed& p)
+            : segments_mapping(p.segments_mapping), generations(p.generations),
+              bitWidths(p.bitWidths), simplified_pc(p.simplified_pc),
+              fst_unused_id(p.fst_unused_id), projection(p.projection)
+        {
+            definitions.reserve(p.definitions.size());
+            for (const auto& d : p.definitions)
+                definitions.push_back(Definition(d.first, Formulas.get(d.second)));
+            path_condition.reserve(p.path_condition.size());
+            for (FormulaPool::Ref r : p.path_condition)
+                path_condition.push_back(Formulas.get(r));
+        }
+
         Formula::Ident build_item(Value val) const {
             assert(val.type == Value::Type::Variable);
             int segment_mapped_to = segments_mapping[val.variable.segmentId];
@@ -150,24 +375,49 @@ namespace llvm_sym {
             if (path_condition.empty())
                 return;
             if (unknown_instances <= 4)
-                // instances are very easy (solving time < 10ms), it is a waste to simplify
+                // instances are very easy (solving time < 10ms), it is a waste
+                // to simplify, the conjuncts stay unsimplified for later
                 return;
 
-            Formula conj;
-            for (Formula &pc : path_condition)
-                conj = conj && pc;
-
             if (Config.is_set("--cheapsimplify")) {
+                Formula conj;
+                for (Formula &pc : path_condition)
+                    conj = conj && pc;
                 auto simplified = cheap_simplify(conj);
                 path_condition.resize(1);
                 path_condition.back() = simplified;
             }
             else if (!Config.is_set("--dontsimplify")) {
-                // regular, full, expensive simplify
-                auto simplified = llvm_sym::simplify(conj);
-                path_condition.resize(1);
-                path_condition.back() = simplified;
+                // only the new conjuncts if the prefix is simplified already
+                simplify_incremental(path_condition, simplified_pc);
             }
+            simplified_pc = path_condition.size();
+        }
+
+        /**
+         * Removes constraints which cannot influence the live variables, see
+         * BaseSMTStore::collect_garbage. The state has to be satisfiable.
+         */
+        void collect_garbage() {
+            Statistics::getCounter(GC_REMOVED) += BaseSMTStore::collect_garbage(
+                segments_mapping, generations, definitions, path_condition);
+        }
+
+        /**
+         * Canonicalizes the state before it is stored or compared, see
+         * BaseSMTStore::renumber_generations
+         */
+        void renumber_generations() {
+            BaseSMTStore::renumber_generations(segments_mapping, generations,
+                [&](const IdentVisitor& f) {
+                    for (Definition& d : definitions) {
+                        f(d.symbol);
+                        d.def.for_each_identifier(f);
+                    }
+                    for (Formula& pc : path_condition)
+                        pc.for_each_identifier(f);
+                });
+            std::sort(definitions.begin(), definitions.end());
         }
 
         virtual size_t getSize() const {
@@ -181,6 +431,7 @@ namespace llvm_sym {
             for (const Formula &pc : path_condition) {
                 size += representation_size(pc._rpn);
             }
+            size += sizeof(size_t);
 
             return size;
         }
@@ -197,6 +448,7 @@ namespace llvm_sym {
             for (const Formula &pc : path_condition) {
                 blobWrite(mem, pc._rpn);
             }
+            blobWrite(mem, simplified_pc);
         }
 
         virtual void readData(const char * &mem) {
@@ -215,6 +467,7 @@ namespace llvm_sym {
             for (unsigned i = 0; i < pc_size; ++i) {
                 blobRead(mem, path_condition[i]._rpn);
             }
+            blobRead(mem, simplified_pc);
 
             assert(segments_mapping.size() == generations.size());
             assert(segments_mapping.size() == bitWidths.size());
@@ -237,21 +490,18 @@ namespace llvm_sym {
         }
 
         virtual void addSegment(unsigned id, const std::vector< int > &bit_widths) {
-            segments_mapping.insert(segments_mapping.begin() + id, fst_unused_id++);
-            generations.emplace(generations.begin() + id, bit_widths.size(), 0);
-            bitWidths.insert(bitWidths.begin() + id, std::vector< char >(bit_widths.size()));
+            if (id >= segments_mapping.size()) {
+                segments_mapping.resize(id + 1);
+                generations.resize(id + 1);
+                bitWidths.resize(id + 1);
+            }
+            segments_mapping[id] = fst_unused_id++;
+            generations[id].assign(bit_widths.size(), 0);
+            bitWidths[id].resize(bit_widths.size());
 
             for (size_t i = 0; i < bit_widths.size(); ++i) {
                 bitWidths[id][i] = static_cast< char >(bit_widths[i]);
             }
-
-            for (unsigned offset = 0; offset < bit_widths.size(); ++offset) {
-                Value new_val;
-                new_val.type = Value::Type::Variable;
-                new_val.variable.segmentId = id;
-                new_val.variable.offset = offset;
-                //implement_store( new_val, Value( 0, bit_widths[ offset ] ) );
-            }
         }
 
         virtual void eraseSegment(int id) {
@@ -261,12 +511,26 @@ namespace llvm_sym {
             };
             removeDefinitions(in_segment_predicate);
             //removeConditions( in_segment_predicate_f );
-            segments_mapping.erase(segments_mapping.begin() + id);
-            generations.erase(generations.begin() + id);
-            bitWidths.erase(bitWidths.begin() + id);
+            generations[id].clear();
+            bitWidths[id].clear();
             simplify();
         }
 
+        virtual void truncateSegments(unsigned count) {
+            if (count < segments_mapping.size()) {
+                segments_mapping.resize(count);
+                generations.resize(count);
+                bitWidths.resize(count);
+            }
+        }
+
+        virtual void remapSegments(const std::vector< int > &map) {
+            assert(map.size() == segments_mapping.size());
+            remap_segments(map, segments_mapping);
+            remap_segments(map, generations);
+            remap_segments(map, bitWidths);
+        }
+
         template < typename Predicate >
             void removeDefinitions(Predicate pred) {
                 std::vector< Definition > to_remove(definitions.size());
@@ -306,6 +570,9 @@ namespace llvm_sym {
             void removeConditions(Predicate pred) {
                 // precondition: run removeDefinition( pred ) to be sure that the symbols
                 // are not used anywhere else
+                simplified_pc = std::count_if(path_condition.begin(),
+                    path_condition.begin() + simplified_pc,
+                    [&](Formula &f) { return !pred(f); });
                 auto it = std::remove_if(path_condition.begin(), path_condition.end(), pred);
                 path_condition.resize(it - path_condition.begin());
             }
@@ -320,16 +587,51 @@ namespace llvm_sym {
 
         virtual bool empty();
 
+        virtual void collect_constraints(std::vector<Definition>& defs,
+            std::vector<Formula>& pcs) const
+        {
+            defs.insert(defs.end(), definitions.begin(), definitions.end());
+            pcs.insert(pcs.end(), path_condition.begin(), path_condition.end());
+        }
+
         static bool subseteq(const SMTStore &a, const SMTStore &b, bool timeout,
             bool enable_cache);
 
+        // Subseteq against a stored state without unpacking it
+        static bool subseteq(const SMTStore &a, const Packed &b, bool timeout,
+            bool enable_cache);
+
+        /**
+         * Computes the projection on the first use, the store must not be
+         * modified afterwards. The timeout of the elimination does not depend
+         * on --disabletimeout and failed eliminations are not repeated for
+         * the same constraints.
+         */
+        const Projection& get_projection() const;
+
+        static const unsigned projection_timeout = 200; // ms
+        // Maximal size of the projection relative to the constraints
+        static const size_t projection_growth = 4;
+
         void clear() {
             path_condition.clear();
+            simplified_pc = 0;
             definitions.clear();
             segments_mapping.clear();
         }
 
         friend std::ostream & operator<<(std::ostream & o, const SMTStore &v);
+
+    private:
+        /**
+         * Solver part of subseteq, the stored state is given unpacked (a) or
+         * packed (packed_a). The packed one is unpacked only if the query
+         * needs its formulas.
+         */
+        static bool query_subseteq(const SMTStore &b, const SMTStore *a,
+            const Packed *packed_a,
+            const std::map< Formula::Ident, Formula::Ident > &to_compare,
+            bool timeout, bool is_caching_enabled);
     };
 
     std::ostream & operator<<(std::ostream & o, const SMTStore &v);
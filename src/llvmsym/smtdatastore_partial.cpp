@@ -64,6 +64,17 @@ bool SMTStorePartial::empty()
         set.push_back(&group.second);
     }
 
+    std::vector<Definition> defs;
+    std::vector<Formula> pcs;
+    for (const auto& g : set) {
+        defs.insert(defs.end(), g->get_definitions().begin(), g->get_definitions().end());
+        pcs.insert(pcs.end(), g->get_path_condition().begin(), g->get_path_condition().end());
+    }
+    if (abstract_empty(defs, pcs)) {
+        assert(!test_run || smtstore_res);
+        return true;
+    }
+
     if (simplify) {
         query = simp.Simplify(query);
     }
@@ -121,6 +132,10 @@ bool SMTStorePartial::subseteq(
         return true;
     }
 
+    if (abstract_not_subseteq(a_group.get_definitions(), a_group.get_path_condition(),
+            b_group.get_definitions(), b_group.get_path_condition(), to_compare))
+        return false;
+
     // pc_b && foreach(a).(!pc_a || a!=b)
     // (sat iff not _b_ subseteq _a_)
     static z3::context c;
@@ -171,36 +186,40 @@ bool SMTStorePartial::subseteq(
     StopWatch solving_time;
     solving_time.start();
 
+    std::vector< Formula::Ident > a_atoms, b_atoms;
+    for (const auto &vars : to_compare) {
+        a_atoms.push_back(vars.first);
+        b_atoms.push_back(vars.second);
+    }
+    QuerySide side_a = query_side(a_group.get_definitions(),
+        a_group.get_path_condition(), a_atoms);
+    QuerySide side_b = query_side(b_group.get_definitions(),
+        b_group.get_path_condition(), b_atoms);
+
     z3::expr pc_a = c.bool_val(true);
-    for (const auto &pc : a_group.get_path_condition())
-        pc_a = pc_a && toz3(pc, 'a', c);
+    for (const auto &f : side_a.constraints)
+        pc_a = pc_a && toz3(f, 'a', c);
     z3::expr pc_b = c.bool_val(true);
-    for (const auto &pc : b_group.get_path_condition())
-        pc_b = pc_b && toz3(pc, 'b', c);
-
-    for (const Definition &def : a_group.get_definitions())
-        pc_a = pc_a && toz3(def.to_formula(), 'a', c);
-    for (const Definition &def : b_group.get_definitions())
-        pc_b = pc_b && toz3(def.to_formula(), 'b', c);
+    for (const auto &f : side_b.constraints)
+        pc_b = pc_b && toz3(f, 'b', c);
 
     z3::expr distinct = c.bool_val(false);
 
-    for (const auto &vars : to_compare) {
-        z3::expr a_expr = toz3(Formula::buildIdentifier(vars.first), 'a', c);
-        z3::expr b_expr = toz3(Formula::buildIdentifier(vars.second), 'b', c);
+    for (size_t i = 0; i < side_a.atoms.size(); ++i) {
+        z3::expr a_expr = toz3(side_a.atoms[i], 'a', c);
+        z3::expr b_expr = toz3(side_b.atoms[i], 'b', c);
 
         distinct = distinct || (a_expr != b_expr);
     }
 
+    // Compared variables unconstrained in a are quantified too
     std::vector< z3::expr > a_all_vars;
-    for (const auto &var : a_group.collect_variables()) {
+    for (const auto &var : side_a.variables()) {
         a_all_vars.push_back(toz3(Formula::buildIdentifier(var), 'a', c));
     }
 
     z3::expr not_witness = !pc_a || distinct;
-    z3::expr query = pc_b;
-    if (!a_all_vars.empty())
-        query = query && forall(a_all_vars, not_witness);
+    z3::expr query = pc_b && (a_all_vars.empty() ? not_witness : forall(a_all_vars, not_witness));
 
     if (simplify) {
         query = simp.Simplify(query);
@@ -26,15 +26,26 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
     bool test_run;
     SMTStore store;
 
+public:
+    /**
+     * Dependency groups are not pooled, the store is kept in the database as
+     * is, i.e. the partial store gets no compression by the formula pool
+     */
+    typedef SMTStorePartial Packed;
+
+private:
+
     class dependency_group {
         std::set<Formula::Ident> group;
         std::vector<Formula> path_condition;
         std::vector<Definition> definitions;
         TriState pc_state;
+        size_t pc_simplified; // Leading conjuncts simplified already
     public:
         dependency_group(const std::set<Formula::Ident>& g = {},
             const std::vector<Formula>& pc = {}, const std::vector<Definition>& d = {})
-        : path_condition(pc), definitions(d), pc_state(TriState::UNKNOWN)
+        : path_condition(pc), definitions(d), pc_state(TriState::UNKNOWN),
+          pc_simplified(0)
         {
             for (Formula::Ident id : g) {
                 id.gen = 0;
@@ -68,6 +79,7 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
         void append(const dependency_group& g) {
             std::copy(g.group.cbegin(), g.group.cend(), std::inserter(group, group.end()));
             std::copy(g.path_condition.cbegin(), g.path_condition.cend(), std::back_inserter(path_condition));
+            // The appended conjuncts are simplified in the context of ours later
             std::vector<Definition> new_defs;
             new_defs.reserve(definitions.size() + g.definitions.size());
             std::merge(definitions.begin(), definitions.end(),
@@ -110,6 +122,30 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
                 def.collect_variables(v);
         }
 
+        /**
+         * Lets gc remove definitions and path conditions of the group
+         * @return number of removed constraints returned by gc
+         */
+        template <class GC>
+        size_t collect_garbage(const GC& gc) {
+            return gc(definitions, path_condition);
+        }
+
+        /**
+         * Calls f on every identifier of the group, the group keeps its
+         * definitions sorted if f changes them
+         */
+        template <class F>
+        void for_each_identifier(const F& f) {
+            for (auto& def : definitions) {
+                f(def.symbol);
+                def.def.for_each_identifier(f);
+            }
+            for (auto& pc : path_condition)
+                pc.for_each_identifier(f);
+            std::sort(definitions.begin(), definitions.end());
+        }
+
         bool depends_on(int seg, int offset, int generation) const {
             // ToDo: Can be simplified!
             // We could use a dependency group
@@ -128,22 +164,20 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
         }
 
         void simplify_pc() {
-            if (path_condition.empty())
+            if (pc_simplified == path_condition.size())
                 return;
-            Formula conj;
-            for (const Formula& pc : path_condition)
-                conj = conj && pc;
 
             if (Config.is_set("--cheapsimplify")) {
+                Formula conj;
+                for (const Formula& pc : path_condition)
+                    conj = conj && pc;
                 auto simplified = cheap_simplify(conj);
                 path_condition.resize(1);
                 path_condition.back() = simplified;
             }
-            else if (!Config.is_set("--dontsimplify")) {
-                auto simplified = llvm_sym::simplify(conj);
-                path_condition.resize(1);
-                path_condition.back() = simplified;
-            }
+            else if (!Config.is_set("--dontsimplify"))
+                simplify_incremental(path_condition, pc_simplified);
+            pc_simplified = path_condition.size();
         }
 
         size_t getSize() const {
@@ -205,6 +239,8 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
             }
 
             blobRead(mem, pc_state);
+            // Stored states are simplified after every pushed condition
+            pc_simplified = path_condition.size();
         }
 
         template <typename Predicate>
@@ -248,6 +284,9 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
 
         template <typename Predicate>
         void removeConditions(Predicate pred) {
+            pc_simplified = std::count_if(path_condition.begin(),
+                path_condition.begin() + pc_simplified,
+                [&](Formula& f) { return !pred(f); });
             auto it = std::remove_if(path_condition.begin(),
                 path_condition.end(), pred);
             path_condition.resize(it - path_condition.begin());
@@ -486,6 +525,42 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
         }
     }
 
+    /**
+     * Removes constraints which cannot influence the live variables, see
+     * BaseSMTStore::collect_garbage. The state has to be satisfiable.
+     */
+    void collect_garbage()
+    {
+        if (test_run)
+            store.collect_garbage();
+        // Groups are closed under shared variables, so they are collected separately
+        size_t removed = 0;
+        for (auto& group : sym_data) {
+            removed += group.second.collect_garbage(
+                [&](std::vector<Definition>& defs, std::vector<Formula>& pcs) {
+                    return BaseSMTStore::collect_garbage(segments_mapping, generations, defs, pcs);
+                });
+        }
+        if (removed)
+            group_cleanup();
+        Statistics::getCounter(GC_REMOVED) += removed;
+    }
+
+    /**
+     * Canonicalizes the state before it is stored or compared, see
+     * BaseSMTStore::renumber_generations
+     */
+    void renumber_generations()
+    {
+        if (test_run)
+            store.renumber_generations();
+        BaseSMTStore::renumber_generations(segments_mapping, generations,
+            [&](const IdentVisitor& f) {
+                for (auto& group : sym_data)
+                    group.second.for_each_identifier(f);
+            });
+    }
+
     virtual size_t getSize() const
     {
         int size = representation_size(segments_mapping, generations, bitWidths, fst_unused_id, test_run);
@@ -587,21 +662,18 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
     {
         if (test_run)
             store.addSegment(id, bit_widths);
-        segments_mapping.insert( segments_mapping.begin() + id, fst_unused_id++ );
-        generations.emplace( generations.begin() + id, bit_widths.size(), 0 );
-        bitWidths.insert( bitWidths.begin() + id, std::vector< char >( bit_widths.size() ) );
+        if ( id >= segments_mapping.size() ) {
+            segments_mapping.resize( id + 1 );
+            generations.resize( id + 1 );
+            bitWidths.resize( id + 1 );
+        }
+        segments_mapping[ id ] = fst_unused_id++;
+        generations[ id ].assign( bit_widths.size(), 0 );
+        bitWidths[ id ].resize( bit_widths.size() );
 
         for ( size_t i = 0; i < bit_widths.size(); ++i ) {
             bitWidths[ id ][ i ] = static_cast< char >( bit_widths[ i ] );
         }
-
-        for ( unsigned offset = 0; offset < bit_widths.size(); ++offset ) {
-            Value new_val;
-            new_val.type = Value::Type::Variable;
-            new_val.variable.segmentId = id;
-            new_val.variable.offset = offset;
-            //implement_store( new_val, Value( 0, bit_widths[ offset ] ) );
-        }
     }
 
     virtual void eraseSegment( int id )
@@ -614,12 +686,32 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
         };
         removeDefinitions( in_segment_predicate );
         //removeConditions( in_segment_predicate_f );
-        segments_mapping.erase( segments_mapping.begin() + id );
-        generations.erase( generations.begin() + id );
-        bitWidths.erase( bitWidths.begin() + id );
+        generations[ id ].clear();
+        bitWidths[ id ].clear();
         simplify();
     }
 
+    virtual void truncateSegments( unsigned count )
+    {
+        if (test_run)
+            store.truncateSegments(count);
+        if ( count < segments_mapping.size() ) {
+            segments_mapping.resize( count );
+            generations.resize( count );
+            bitWidths.resize( count );
+        }
+    }
+
+    virtual void remapSegments( const std::vector< int > &map )
+    {
+        if (test_run)
+            store.remapSegments(map);
+        assert( map.size() == segments_mapping.size() );
+        remap_segments( map, segments_mapping );
+        remap_segments( map, generations );
+        remap_segments( map, bitWidths );
+    }
+
     template < typename Predicate >
     void removeDefinitions( Predicate pred )
     {
@@ -656,6 +748,17 @@ class SMTStorePartial : public BaseSMTStore<SMTStorePartial> {
 
     virtual bool empty();
 
+    virtual void collect_constraints(std::vector<Definition>& defs,
+        std::vector<Formula>& pcs) const
+    {
+        for (const auto& group : sym_data) {
+            const auto& d = group.second.get_definitions();
+            const auto& p = group.second.get_path_condition();
+            defs.insert(defs.end(), d.begin(), d.end());
+            pcs.insert(pcs.end(), p.begin(), p.end());
+        }
+    }
+
     static bool subseteq(const SMTStorePartial &a, const SMTStorePartial &b,
         bool timeout, bool cache);
     static bool subseteq(
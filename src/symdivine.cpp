@@ -1,5 +1,6 @@
 #include "llvmsym/programutils/config.h"
 #include <iostream>
+#include <fstream>
 #include <string>
 
 #include "toolkit/z3cache.h"
@@ -17,6 +18,10 @@ void process_statistics(T& t) {
         std::cout << "\n";
         Z3cache.dump_stat(std::cout);
         std::cout << "\n";
+        SimplifyCache.dump_stat(std::cout, "Simplification cache statistics");
+        std::cout << "\n";
+        Formulas.dump_stat(std::cout);
+        std::cout << "\n";
 
         size_t time = 0;
         Z3cache.process(
@@ -25,12 +30,31 @@ void process_statistics(T& t) {
         });
         std::cout << "Time saved:    " << time << " us\n";
     }
+
+    if (Config.is_set("--stats-json")) {
+        std::ofstream o(Config.get_string("--stats-json"));
+        StatInfo cache = Z3cache.get_stat();
+        StatInfo simplify_cache = SimplifyCache.get_stat();
+        o << "{\n"
+          << "  \"states\": " << t.state_count() << ",\n"
+          << "  \"solver_calls\": " << Statistics::getCounter(QF_N_SIMP)
+                + Statistics::getCounter(Q_N_SIMP) << ",\n"
+          << "  \"cache_hits\": " << cache.hit_count << ",\n"
+          << "  \"cache_misses\": " << cache.miss_count << ",\n"
+          << "  \"simplify_cache_hits\": " << simplify_cache.hit_count << ",\n"
+          << "  \"simplify_cache_misses\": " << simplify_cache.miss_count << ",\n"
+          << "  \"formulas\": " << Formulas.size() << ",\n"
+          << "  \"counters\": ";
+        Statistics::dumpJson(o);
+        o << "\n}\n";
+    }
 }
 
 int main(int args, char *argv[])
 {
     try {
         Config.parse_cmd_args(args, argv);
+        SimplifyCache.set_capacity(Config.get_long("--simplify-cache"));
 
         if (Config.is_set("--version")) {
             std::cout << "SymDIVINE v0.5\n";
@@ -53,6 +77,24 @@ int main(int args, char *argv[])
         }
 
         if (Config.is_set("ltl")) {
+            // Checkpoints are taken only by the nested DFS
+            if (Config.is_set("--resume")
+                && (Config.is_set("--owcty") || Config.is_set("--scc")))
+            {
+                std::cerr << "--resume cannot be combined with --owcty or --scc\n";
+                return 1;
+            }
+            // OWCTY builds the whole product graph on its own
+            if (Config.is_set("--owcty")) {
+                for (const char* option : { "--bound", "--iterative",
+                    "--checkpoint", "--space_output" })
+                {
+                    if (Config.is_set(option)) {
+                        std::cerr << option << " cannot be combined with --owcty\n";
+                        return 1;
+                    }
+                }
+            }
             Ltl<SMTStore, SMTSubseteq<SMTStore>>
                 ltl(Config.get_string("<model>"), Config.get_string("<property>"),
                     Config.is_set("--iterative") || Config.is_set("--bound"));
@@ -0,0 +1,241 @@
+/**
+ * Microbenchmarks of the verification kernels. The kernels run over a fixed
+ * corpus of states captured from a real run by
+ *     symdivine reachability <model> --capture-states=<corpus>
+ * (add --partialstore to capture states of the partial store). The remaining
+ * options are passed to the kernels as symdivine options, e.g. --disabletimeout.
+ * Note that with --enablecaching the query cache is shared by the repetitions.
+ *
+ * Every kernel is repeated and the minimum and median times are reported. The
+ * checksum of the results has to be the same for all runs on the same corpus.
+ */
+
+#include "llvmsym/programutils/config.h"
+#include "llvmsym/blobing.h"
+#include "llvmsym/smtdatastore.h"
+#include "llvmsym/smtdatastore_partial.h"
+#include "llvmsym/formula/z3.h"
+#include "toolkit/state_corpus.h"
+#include "toolkit/z3cache.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+const char BENCH_USAGE[] =
+    "Usage: symdivine_bench <corpus> [--repeat=<n>] [--kernel=<name>] [symdivine options]\n"
+    "Kernels: roundtrip toz3 fromz3 simplify cheap_simplify empty subseteq insertCheck\n";
+
+struct Bench {
+    size_t repeat = 5;
+    std::string kernel; // Empty for all kernels
+    size_t checksum = 0;
+
+    /**
+     * Runs f repeatedly and prints its times, f performs ops operations and
+     * returns a value which is added to the checksum
+     */
+    template <class F>
+    void measure(const std::string& name, size_t ops, F f) {
+        if (!kernel.empty() && name != kernel)
+            return;
+        std::vector<double> times;
+        size_t result = 0;
+        for (size_t i = 0; i != repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            result = f();
+            std::chrono::duration<double, std::milli> t =
+                std::chrono::steady_clock::now() - start;
+            times.push_back(t.count());
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        checksum = checksum * 31 + result;
+        std::cout << std::left << std::setw(16) << name << std::right
+                  << std::setw(8) << ops
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(12) << times.front()
+                  << std::setw(12) << median
+                  << std::setprecision(0)
+                  << std::setw(14) << (ops ? median * 1e6 / ops : 0.0) << std::endl;
+    }
+};
+
+Blob to_blob(const CorpusState& st) {
+    Blob b(st.data.size(), st.explicit_size, st.user_size);
+    memcpy(b.getUser(), st.data.data(), st.data.size());
+    return b;
+}
+
+template <class Store>
+Store to_store(const Blob& b) {
+    Store s;
+    const char* mem = b.getSymb();
+    s.readData(mem);
+    return s;
+}
+
+template <class Store>
+void run_kernels(Bench& bench, const std::vector<CorpusState>& corpus) {
+    std::vector<Blob> blobs;
+    std::vector<Store> stores;
+    std::vector<Formula> formulas; // Conjunctions of the path conditions
+    for (const auto& st : corpus) {
+        blobs.push_back(to_blob(st));
+        stores.push_back(to_store<Store>(blobs.back()));
+
+        std::vector<Definition> defs;
+        std::vector<Formula> pcs;
+        stores.back().collect_constraints(defs, pcs);
+        Formula conj;
+        for (const auto& pc : pcs)
+            conj = conj && pc;
+        formulas.push_back(conj);
+    }
+
+    // States with the same explicit part are the ones compared in the database
+    std::map<std::string, std::vector<size_t>> groups;
+    for (size_t i = 0; i != corpus.size(); i++) {
+        const auto& st = corpus[i];
+        groups[st.data.substr(0, st.user_size + st.explicit_size)].push_back(i);
+    }
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (const auto& g : groups) {
+        for (size_t i = 0; i != g.second.size(); i++) {
+            for (size_t j = 0; j != g.second.size(); j++) {
+                if (i != j)
+                    pairs.push_back({ g.second[i], g.second[j] });
+            }
+        }
+    }
+
+    bool timeout = !Config.is_set("--disabletimeout");
+    bool cache = Config.is_set("--enablecaching");
+
+    bench.measure("roundtrip", stores.size(), [&]() {
+        size_t res = 0;
+        std::vector<char> buffer;
+        for (const auto& s : stores) {
+            buffer.resize(s.getSize());
+            char* out = buffer.data();
+            s.writeData(out);
+            Store t;
+            const char* in = buffer.data();
+            t.readData(in);
+            res += t.getSize();
+        }
+        return res;
+    });
+
+    z3::context c;
+    bench.measure("toz3", formulas.size(), [&]() {
+        size_t res = 0;
+        for (const auto& f : formulas)
+            res += toz3(f, 'a', c).hash();
+        return res;
+    });
+
+    std::vector<z3::expr> exprs;
+    for (const auto& f : formulas)
+        exprs.push_back(toz3(f, 'a', c));
+    bench.measure("fromz3", exprs.size(), [&]() {
+        size_t res = 0;
+        for (const auto& e : exprs)
+            res += fromz3(e)._rpn.size();
+        return res;
+    });
+
+    bench.measure("simplify", formulas.size(), [&]() {
+        SimplifyCache.clear();
+        size_t res = 0;
+        for (const auto& f : formulas)
+            res += simplify(f)._rpn.size();
+        return res;
+    });
+
+    bench.measure("cheap_simplify", formulas.size(), [&]() {
+        size_t res = 0;
+        for (const auto& f : formulas)
+            res += cheap_simplify(f)._rpn.size();
+        return res;
+    });
+
+    bench.measure("empty", stores.size(), [&]() {
+        size_t res = 0;
+        for (const auto& s : stores) {
+            Store t = s;
+            res += t.empty();
+        }
+        return res;
+    });
+
+    bench.measure("subseteq", pairs.size(), [&]() {
+        size_t res = 0;
+        for (const auto& p : pairs)
+            res += Store::subseteq(stores[p.first], stores[p.second], timeout, cache);
+        return res;
+    });
+
+    bench.measure("insertCheck", blobs.size(), [&]() {
+        Database<Blob, Store, LinearCandidate<Store, SMTSubseteq<Store>>> db;
+        size_t res = 0;
+        for (size_t i = 0; i != blobs.size(); i++)
+            res += db.insertCheck(blobs[i], corpus[i].chunks).first;
+        return res;
+    });
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        std::cerr << BENCH_USAGE;
+        return 1;
+    }
+
+    try {
+        Bench bench;
+        std::vector<std::string> args = { "symdivine", "reachability", argv[1] };
+        for (int i = 2; i != argc; i++) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 9, "--repeat=") == 0)
+                bench.repeat = std::max(1, std::stoi(arg.substr(9)));
+            else if (arg.compare(0, 9, "--kernel=") == 0)
+                bench.kernel = arg.substr(9);
+            else
+                args.push_back(arg);
+        }
+        std::vector<char*> cargs;
+        for (auto& a : args)
+            cargs.push_back(&a[0]);
+        Config.parse_cmd_args(cargs.size(), cargs.data());
+        SimplifyCache.set_capacity(Config.get_long("--simplify-cache"));
+
+        std::string store;
+        auto corpus = read_corpus(argv[1], store);
+        std::cout << "Corpus: " << corpus.size() << " states (" << store << " store)\n"
+                  << "Repetitions: " << bench.repeat << "\n\n"
+                  << std::left << std::setw(16) << "kernel" << std::right
+                  << std::setw(8) << "ops" << std::setw(12) << "min [ms]"
+                  << std::setw(12) << "median [ms]" << std::setw(14) << "median [ns/op]"
+                  << "\n";
+
+        if (store == "partial")
+            run_kernels<SMTStorePartial>(bench, corpus);
+        else
+            run_kernels<SMTStore>(bench, corpus);
+        std::cout << "\nChecksum: " << bench.checksum << "\n";
+    }
+    catch (const StateCorpusException& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    catch (const z3::exception& e) {
+        std::cerr << "Z3 error: " << e.msg() << "\n";
+        return 1;
+    }
+    return 0;
+}
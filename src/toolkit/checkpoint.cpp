@@ -0,0 +1,156 @@
+#include <toolkit/checkpoint.h>
+#include <iostream>
+#include <thread>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+const unsigned Checkpointer::finish_timeout;
+const unsigned Checkpointer::stuck_intervals;
+
+namespace {
+
+/**
+ * Flushes the file or directory to disk
+ */
+bool sync_path(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+std::string directory_of(const std::string& path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace
+
+Checkpointer::Checkpointer(const std::string& filename, unsigned interval)
+    : filename(filename), interval(interval),
+      last(std::chrono::steady_clock::now()), child(0), started(last)
+{}
+
+Checkpointer::~Checkpointer() {
+    auto deadline = std::chrono::steady_clock::now()
+        + std::chrono::seconds(finish_timeout);
+    while (!reap(false)) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            kill_child();
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+bool Checkpointer::reap(bool wait) {
+    if (child == 0)
+        return true;
+    int status;
+    pid_t r = waitpid(child, &status, wait ? 0 : WNOHANG);
+    if (r == 0)
+        return false;
+    if (r == child && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+        std::cerr << "Checkpoint " << filename << " was not written\n";
+    child = 0;
+    return true;
+}
+
+void Checkpointer::kill_child() {
+    kill(child, SIGKILL);
+    reap(true);
+    std::remove((filename + ".tmp").c_str());
+}
+
+bool Checkpointer::due() {
+    if (filename.empty())
+        return false;
+    auto now = std::chrono::steady_clock::now();
+    if (now - last < interval)
+        return false;
+    if (reap(false))
+        return true;
+    if (now - started < stuck_intervals * interval)
+        return false;
+    std::cerr << "Checkpoint writer is stuck, killing it\n";
+    kill_child();
+    return true;
+}
+
+bool Checkpointer::single_threaded() {
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir)
+        return true; // Cannot tell, the threads of the tool are listed there
+    size_t threads = 0;
+    while (dirent* e = readdir(dir)) {
+        if (e->d_name[0] != '.')
+            threads++;
+    }
+    closedir(dir);
+    return threads <= 1;
+}
+
+void Checkpointer::write(const std::function<void(SnapshotWriter&)>& save) {
+    if (!reap(false))
+        return;
+    last = std::chrono::steady_clock::now();
+    if (!single_threaded()) {
+        std::cerr << "Skipping checkpoint, other threads are running\n";
+        return;
+    }
+
+    // Buffered output would be flushed twice otherwise
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Cannot fork checkpoint writer\n";
+        return;
+    }
+    if (pid > 0) {
+        child = pid;
+        started = last;
+        return;
+    }
+
+    // The child owns a copy-on-write image of the state, it only serializes
+    // it and leaves without running any destructors
+    std::string tmp = filename + ".tmp";
+    bool ok = false;
+    try {
+        std::ofstream o(tmp, std::ios::binary | std::ios::trunc);
+        SnapshotWriter w(o);
+        save(w);
+        o.close();
+        ok = static_cast<bool>(o) && sync_path(tmp);
+        if (!ok)
+            std::cerr << "Cannot write checkpoint to " << tmp << "\n";
+    }
+    catch (std::exception& e) {
+        std::cerr << "Cannot write checkpoint: " << e.what() << "\n";
+    }
+    if (ok && std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Cannot replace checkpoint " << filename << "\n";
+        ok = false;
+    }
+    // The rename is durable once the directory entry is synced
+    if (ok && !sync_path(directory_of(filename))) {
+        std::cerr << "Cannot sync directory of checkpoint " << filename << "\n";
+        ok = false;
+    }
+    _exit(ok ? 0 : 1);
+}
+
+void Checkpointer::open(const std::string& filename, std::ifstream& in) {
+    in.open(filename, std::ios::binary);
+    if (!in)
+        throw CheckpointException("Cannot open checkpoint " + filename);
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+/**
+ * Checkpointing of long runs. Components serialize themselves into a single
+ * binary snapshot via SnapshotWriter (method save) and restore from it via
+ * SnapshotReader (method load). Checkpointer forks the process and lets the
+ * child serialize its copy-on-write image of the state directly to disk, so
+ * the exploration is neither stopped nor duplicated in memory. The process
+ * has to be single threaded at the time of the fork, otherwise the child may
+ * inherit locks held by the other threads.
+ */
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include <istream>
+#include <fstream>
+#include <functional>
+#include <chrono>
+#include <sys/types.h>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <llvmsym/formula/rpn.h>
+
+class CheckpointException : public std::runtime_error {
+public:
+    CheckpointException(const std::string& msg) : std::runtime_error(msg) { }
+};
+
+class SnapshotWriter {
+public:
+    SnapshotWriter(std::ostream& o) : out(o) {}
+
+    template <class T>
+    typename std::enable_if<std::is_trivially_copyable<T>::value>::type
+    write(const T& v) {
+        out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template <class T>
+    typename std::enable_if<!std::is_trivially_copyable<T>::value>::type
+    write(const T& v) {
+        v.save(*this);
+    }
+
+    template <class T>
+    void write(const std::vector<T>& v) {
+        write(v.size());
+        for (const auto& e : v)
+            write(e);
+    }
+
+    template <class A, class B>
+    void write(const std::pair<A, B>& p) {
+        write(p.first);
+        write(p.second);
+    }
+
+    void write(const std::string& s) {
+        write(s.size());
+        out.write(s.data(), s.size());
+    }
+
+    void write(const llvm_sym::Formula& f) {
+        write(f._rpn);
+    }
+
+private:
+    std::ostream& out;
+};
+
+/**
+ * Reads snapshot from a stream, the snapshot is not loaded into memory as
+ * a whole
+ */
+class SnapshotReader {
+public:
+    SnapshotReader(std::istream& i) : in(i), pos(0), end(0) {
+        in.seekg(0, std::ios::end);
+        end = static_cast<size_t>(in.tellg());
+        in.seekg(0, std::ios::beg);
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_trivially_copyable<T>::value>::type
+    read(T& v) {
+        check(sizeof(T));
+        in.read(reinterpret_cast<char*>(&v), sizeof(T));
+        pos += sizeof(T);
+    }
+
+    template <class T>
+    typename std::enable_if<!std::is_trivially_copyable<T>::value>::type
+    read(T& v) {
+        v.load(*this);
+    }
+
+    template <class T>
+    void read(std::vector<T>& v) {
+        size_t size;
+        read(size);
+        v.resize(size);
+        for (auto& e : v)
+            read(e);
+    }
+
+    template <class A, class B>
+    void read(std::pair<A, B>& p) {
+        read(p.first);
+        read(p.second);
+    }
+
+    void read(std::string& s) {
+        size_t size;
+        read(size);
+        check(size);
+        s.resize(size);
+        in.read(&s[0], size);
+        pos += size;
+    }
+
+    void read(llvm_sym::Formula& f) {
+        read(f._rpn);
+    }
+
+    template <class T>
+    T get() {
+        T v;
+        read(v);
+        return v;
+    }
+
+private:
+    void check(size_t size) const {
+        if (!in || size > end - pos)
+            throw CheckpointException("Checkpoint is truncated");
+    }
+
+    std::istream& in;
+    size_t pos;
+    size_t end; // Size of the snapshot
+};
+
+/**
+ * Periodically writes snapshots to given file. The file is synced and
+ * replaced atomically, so an interrupted write leaves the previous checkpoint
+ * intact. Each snapshot is serialized by a forked child process, at most one
+ * at a time. A writer which does not finish in time is killed.
+ */
+class Checkpointer {
+public:
+    Checkpointer(const std::string& filename = "", unsigned interval = 0);
+    ~Checkpointer();
+
+    /**
+     * Returns true if checkpointing is enabled, the interval has elapsed and
+     * the previous snapshot has already been written
+     */
+    bool due();
+
+    /**
+     * Writes the snapshot in background. The given function is called in
+     * a forked child process and serializes the state into the writer. The
+     * snapshot is skipped if the process runs other threads.
+     */
+    void write(const std::function<void(SnapshotWriter&)>& save);
+
+    /**
+     * Opens snapshot file for SnapshotReader
+     */
+    static void open(const std::string& filename, std::ifstream& in);
+
+    /**
+     * Magic string at the beginning of each snapshot
+     */
+    static const char* header() {
+        return "SymDIVINE checkpoint v1";
+    }
+
+private:
+    std::string filename;
+    std::chrono::seconds interval;
+    std::chrono::steady_clock::time_point last;
+    pid_t child; // Process writing the snapshot, 0 if none
+
+    std::chrono::steady_clock::time_point started; // Start of the child
+
+    // Seconds the writer gets to finish when the run ends
+    static const unsigned finish_timeout = 60;
+    // A writer running longer than this many intervals is considered stuck
+    static const unsigned stuck_intervals = 10;
+
+    /**
+     * Collects the finished child, returns false if it is still running
+     */
+    bool reap(bool wait);
+
+    /**
+     * Kills the running child and removes its incomplete snapshot
+     */
+    void kill_child();
+
+    /**
+     * Returns true if the process runs only the calling thread
+     */
+    static bool single_threaded();
+};
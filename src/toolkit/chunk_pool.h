@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+ * Pool of hash-consed memory chunks. Used for tree compression of explicit
+ * states - a state is stored as a sequence of references to chunks, so the
+ * parts shared by many states (control, memory layout, unchanged segments)
+ * are kept in memory only once.
+ */
+
+#include <vector>
+#include <string>
+#include <unordered_set>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <ostream>
+#include "hash.h"
+
+class ChunkPool {
+public:
+    typedef uint32_t Ref;
+
+    ChunkPool() : index(0, RefHash(this), RefEqual(this)), total_bytes(0) {}
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    /**
+     * Returns reference to chunk with given content. The chunk is inserted
+     * into the pool if it is not present yet.
+     */
+    Ref intern(const char* mem, size_t size) {
+        chunks.emplace_back(mem, size);
+        auto res = index.insert(chunks.size() - 1);
+        if (!res.second)
+            chunks.pop_back();
+        else
+            total_bytes += size;
+        return *res.first;
+    }
+
+    /**
+     * Looks up chunk with given content without inserting it. Returns false
+     * if there is no such chunk.
+     */
+    bool find(const char* mem, size_t size, Ref& ref) {
+        chunks.emplace_back(mem, size);
+        auto res = index.find(chunks.size() - 1);
+        chunks.pop_back();
+        if (res == index.end())
+            return false;
+        ref = *res;
+        return true;
+    }
+
+    const std::string& get(Ref r) const {
+        assert(r < chunks.size());
+        return chunks[r];
+    }
+
+    size_t size() const {
+        return chunks.size();
+    }
+
+    /**
+     * Returns total size of stored chunks in bytes
+     */
+    size_t bytes() const {
+        return total_bytes;
+    }
+
+    template <class Writer>
+    void save(Writer& w) const {
+        w.write(chunks);
+    }
+
+    /**
+     * Loads chunks saved by save, the references are preserved
+     */
+    template <class Reader>
+    void load(Reader& r) {
+        std::vector<std::string> saved;
+        r.read(saved);
+        index.clear();
+        chunks.clear();
+        total_bytes = 0;
+        for (const auto& c : saved)
+            intern(c.data(), c.size());
+        assert(chunks.size() == saved.size());
+    }
+
+private:
+    struct RefHash {
+        RefHash(const ChunkPool* p) : pool(p) {}
+        size_t operator()(Ref r) const {
+            const std::string& c = pool->chunks[r];
+            hash128_t h = spookyHash(c.data(), c.size(), 0, 0);
+            return h.first ^ h.second;
+        }
+        const ChunkPool* pool;
+    };
+
+    struct RefEqual {
+        RefEqual(const ChunkPool* p) : pool(p) {}
+        bool operator()(Ref a, Ref b) const {
+            return pool->chunks[a] == pool->chunks[b];
+        }
+        const ChunkPool* pool;
+    };
+
+    std::vector<std::string> chunks;
+    std::unordered_set<Ref, RefHash, RefEqual> index;
+    size_t total_bytes;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * Compact append-only graph in CSR form. Vertices are identified by dense
+ * 32-bit indices assigned by the owner, e.g. the discovery order of states in
+ * the database, so the graph itself keeps no ids and no hash table. Successor
+ * lists have to be appended in the order of the indices, which holds for
+ * a breadth-first exploration. A vertex costs one 8-byte offset and an edge
+ * 4 bytes.
+ */
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "graph.h"
+
+class CsrGraph {
+public:
+    typedef uint32_t Index;
+
+    CsrGraph() : offsets(1, 0) {}
+
+    /**
+     * Sets successors of given vertex. The vertices have to be expanded in
+     * the order of their indices, vertices skipped over get no successors.
+     */
+    void add_successors(Index from, const std::vector<Index>& succ) {
+        if (from + 1 < offsets.size())
+            throw GraphException("Successors have to be added in index order!");
+        offsets.resize(from + 1, edges.size());
+        edges.insert(edges.end(), succ.begin(), succ.end());
+        offsets.push_back(edges.size());
+    }
+
+    /**
+     * Returns number of expanded vertices
+     */
+    size_t vertex_count() const {
+        return offsets.size() - 1;
+    }
+
+    size_t edge_count() const {
+        return edges.size();
+    }
+
+    /**
+     * Returns range of successor indices of given vertex
+     */
+    std::pair<const Index*, const Index*> get_successors(Index i) const {
+        if (i + 1 >= offsets.size())
+            return { nullptr, nullptr };
+        const Index* data = edges.data();
+        return { data + offsets[i], data + offsets[i + 1] };
+    }
+
+    /**
+     * Outputs the graph, given vertex count includes the vertices which were
+     * discovered but not expanded. The formatters take vertex index.
+     */
+    template <class IdFormat, class LabelFormat, class StyleFormat>
+    void to_dot(std::ostream& o, size_t vertices, IdFormat id_format,
+        LabelFormat label_format, StyleFormat style_format)
+    {
+        o << "digraph state_space {\n";
+        for (Index v = 0; v != vertices; v++) {
+            std::string id = id_format(v);
+            o << "\t" << id << "[label=\"" << label_format(v) << "\""
+              << style_format(v) << "]\n";
+
+            auto succ = get_successors(v);
+            for (; succ.first != succ.second; ++succ.first)
+                o << "\t" << id << " -> " << id_format(*succ.first) << "\n";
+        }
+        o << "\n}\n";
+    }
+
+    /**
+     * Serializes the graph, used for checkpointing
+     */
+    template <class Writer>
+    void save(Writer& w) const {
+        w.write(offsets);
+        w.write(edges);
+    }
+
+    template <class Reader>
+    void load(Reader& r) {
+        r.read(offsets);
+        r.read(edges);
+    }
+
+private:
+    std::vector<uint64_t> offsets; // Position of the first successor in edges
+    std::vector<Index> edges;
+};
@@ -0,0 +1,34 @@
+#include <toolkit/disk_store.h>
+#include <cassert>
+#include <unistd.h>
+
+DiskStore::~DiskStore() {
+    if (file)
+        std::fclose(file);
+}
+
+void DiskStore::open() {
+    file = std::tmpfile();
+    if (!file)
+        throw std::runtime_error("Cannot create temporary file for state storage");
+}
+
+DiskStore::Record DiskStore::append(const std::string& data) {
+    if (!file)
+        open();
+    Record r(static_cast<long>(file_size), data.size());
+    if (pwrite(fileno(file), data.data(), data.size(), r.offset)
+        != static_cast<ssize_t>(data.size()))
+        throw std::runtime_error("Cannot write to state storage file");
+    file_size += data.size();
+    return r;
+}
+
+std::string DiskStore::read(const Record& r) const {
+    assert(file);
+    std::string data(r.size, '\0');
+    if (pread(fileno(file), &data[0], r.size, r.offset)
+        != static_cast<ssize_t>(r.size))
+        throw std::runtime_error("Cannot read from state storage file");
+    return data;
+}
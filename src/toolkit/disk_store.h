@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * Append-only backing file for data spilled out of memory. The file is an
+ * anonymous temporary file and is removed when the store is destroyed.
+ * Outdated records are only counted, the owner rewrites the live ones into
+ * a fresh store when there are too many of them. The file is accessed only
+ * by positional reads and writes, so a forked checkpoint writer can read it
+ * while the exploration appends to it.
+ */
+
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+#include <utility>
+
+class DiskStore {
+public:
+    /**
+     * Location of a record in the file
+     */
+    struct Record {
+        long offset;
+        size_t size;
+
+        Record(long offset = 0, size_t size = 0) : offset(offset), size(size) {}
+    };
+
+    DiskStore() : file(nullptr), file_size(0), garbage_size(0) {}
+    DiskStore(const DiskStore&) = delete;
+    DiskStore& operator=(const DiskStore&) = delete;
+    ~DiskStore();
+
+    /**
+     * Appends data to the end of the file
+     */
+    Record append(const std::string& data);
+
+    /**
+     * Reads previously appended record
+     */
+    std::string read(const Record& r) const;
+
+    /**
+     * Marks record as outdated
+     */
+    void discard(const Record& r) {
+        garbage_size += r.size;
+    }
+
+    void swap(DiskStore& o) {
+        std::swap(file, o.file);
+        std::swap(file_size, o.file_size);
+        std::swap(garbage_size, o.garbage_size);
+    }
+
+    /**
+     * Returns number of bytes written to the file
+     */
+    size_t size() const {
+        return file_size;
+    }
+
+    /**
+     * Returns number of bytes of the outdated records
+     */
+    size_t garbage() const {
+        return garbage_size;
+    }
+
+private:
+    void open();
+
+    std::FILE* file;
+    size_t file_size;
+    size_t garbage_size;
+};
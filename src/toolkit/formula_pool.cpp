@@ -0,0 +1,5 @@
+#include <toolkit/formula_pool.h>
+
+const FormulaPool::Ref FormulaPool::PROBE;
+
+FormulaPool Formulas;
@@ -0,0 +1,146 @@
+#pragma once
+
+/**
+ * Global pool of hash-consed formulas. Stored symbolic states refer to their
+ * formulas by index into the pool, so the formulas shared by many states
+ * (e.g. path conditions of siblings) are kept in memory only once. The
+ * formulas are reference counted, so the ones of states spilled to disk are
+ * released and their slots are reused.
+ */
+
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+#include <ostream>
+#include <llvmsym/formula/rpn.h>
+#include "utils.h"
+
+class FormulaPool {
+public:
+    typedef uint32_t Ref;
+
+    FormulaPool() : index(0, RefHash(this), RefEqual(this)), references(0),
+        total_bytes(0), probe(nullptr) {}
+
+    /**
+     * Returns reference to formula equal to f. The formula is inserted into
+     * the pool if it is not present yet, only then the references returned
+     * by get may be invalidated. Every call has to be paired with release
+     * of the reference.
+     */
+    Ref intern(const llvm_sym::Formula& f) {
+        references++;
+        probe = &f;
+        auto found = index.find(PROBE);
+        probe = nullptr;
+        if (found != index.end()) {
+            counts[*found]++;
+            return *found;
+        }
+
+        Ref slot;
+        if (free_slots.empty()) {
+            slot = formulas.size();
+            formulas.push_back(f);
+            counts.push_back(0);
+        }
+        else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+            formulas[slot] = f;
+        }
+        index.insert(slot);
+        total_bytes += footprint(f);
+        counts[slot]++;
+        return slot;
+    }
+
+    /**
+     * Drops a reference returned by intern, the formula is removed from the
+     * pool when it is not referenced anymore
+     */
+    void release(Ref r) {
+        assert(r < formulas.size() && counts[r] > 0);
+        if (--counts[r] != 0)
+            return;
+        index.erase(r);
+        total_bytes -= footprint(formulas[r]);
+        clear(r);
+        free_slots.push_back(r);
+    }
+
+    const llvm_sym::Formula& get(Ref r) const {
+        assert(r < formulas.size());
+        return formulas[r];
+    }
+
+    /**
+     * Returns number of formulas in the pool
+     */
+    size_t size() const {
+        return formulas.size() - free_slots.size();
+    }
+
+    /**
+     * Returns approximate memory used by the formulas in bytes
+     */
+    size_t bytes() const {
+        return total_bytes;
+    }
+
+    /**
+     * Dumps statistic info to given stream
+     */
+    void dump_stat(std::ostream& s) const {
+        s << "Formula pool statistics" << std::endl;
+        s << "-----------------------" << std::endl;
+        s << "Unique formulas: " << size() << std::endl;
+        s << "References:      " << references << std::endl;
+    }
+
+private:
+    // Key of the formula looked up by intern, it is not stored in the pool
+    static const Ref PROBE = ~Ref(0);
+
+    const llvm_sym::Formula& formula(Ref r) const {
+        return r == PROBE ? *probe : formulas[r];
+    }
+
+    void clear(Ref r) {
+        std::vector<llvm_sym::Formula::Item>().swap(formulas[r]._rpn);
+    }
+
+    static size_t footprint(const llvm_sym::Formula& f) {
+        return sizeof(llvm_sym::Formula) + sizeof(Ref) * 2
+            + f._rpn.size() * sizeof(llvm_sym::Formula::Item);
+    }
+
+    struct RefHash {
+        RefHash(const FormulaPool* p) : pool(p) {}
+        size_t operator()(Ref r) const {
+            return std::hash<llvm_sym::Formula>()(pool->formula(r));
+        }
+        const FormulaPool* pool;
+    };
+
+    struct RefEqual {
+        RefEqual(const FormulaPool* p) : pool(p) {}
+        bool operator()(Ref a, Ref b) const {
+            return pool->formula(a)._rpn == pool->formula(b)._rpn;
+        }
+        const FormulaPool* pool;
+    };
+
+    std::vector<llvm_sym::Formula> formulas;
+    std::vector<uint32_t> counts; // Number of references of each slot
+    std::vector<Ref> free_slots;
+    std::unordered_set<Ref, RefHash, RefEqual> index;
+    size_t references;
+    size_t total_bytes;
+    const llvm_sym::Formula* probe; // Formula looked up as PROBE
+};
+
+/**
+ * Global instance of the formula pool
+ */
+extern FormulaPool Formulas;
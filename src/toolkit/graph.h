@@ -236,6 +236,36 @@ public:
         }        
     }
 
+    /**
+     * Serializes the graph, used for checkpointing
+     */
+    template <class Writer>
+    void save(Writer& w) const {
+        w.write(vertices.size());
+        for (const auto& vertex : vertices) {
+            w.write(vertex.first);
+            w.write(vertex.second.vertex_info);
+            w.write(vertex.second.neighbors);
+            w.write(vertex.second.edge_info);
+        }
+    }
+
+    template <class Reader>
+    void load(Reader& r) {
+        vertices.clear();
+        size_t size;
+        r.read(size);
+        for (size_t i = 0; i != size; i++) {
+            VertexId id;
+            Vertex v;
+            r.read(id);
+            r.read(v.vertex_info);
+            r.read(v.neighbors);
+            r.read(v.edge_info);
+            vertices.insert(std::make_pair(id, v));
+        }
+    }
+
 private:
     /**
      * Stores all information about vertex including adjacency list
@@ -247,4 +277,4 @@ private:
     };
 
     std::unordered_map<VertexId, Vertex, VertexHasher, VertexEq> vertices;
-};
\ No newline at end of file
+};
\ No newline at end of file
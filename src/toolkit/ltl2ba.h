@@ -12,6 +12,7 @@
 #include <boost/graph/graphviz.hpp>
 #include <algorithm>
 #include "graph.h"
+#include "ltl_translate.h"
 #include <llvmsym/formula/rpn.h>
 #include <llvmsym/programutils/config.h>
 
@@ -31,8 +32,9 @@ public:
 };
 
 /**
- * Calls SPOT tool to convert LTL formula to BA, then reads its graphviz output
- * and using given translator for atomic propositions creates Graph of BA
+ * Converts LTL formula to BA using the built-in translator (or SPOT tool as
+ * a fallback) and using given translator for atomic propositions creates Graph
+ * of BA. Translated automata can be cached on disk (--ltl-cache).
  */
 template <class Translator>
 class Ltl2ba {
@@ -64,6 +66,61 @@ public:
     Ltl2ba(const std::string& ltl, Args...args) : ap_translator(args...) {
 	    // Preprocess formula
 	    std::string formula = ap_translator.preprocess(ltl);
+
+        BaDescription desc;
+        std::string cache_dir;
+        if (Config.is_set("--ltl-cache"))
+            cache_dir = Config.get_string("--ltl-cache");
+        bool spot = Config.is_set("--spot");
+        if (cache_dir.empty() || !load_cached_ba(cache_dir, formula, spot, desc)) {
+            desc = translate(formula);
+            if (!cache_dir.empty())
+                store_cached_ba(cache_dir, formula, spot, desc);
+        }
+
+        // Convert BA to Graph class
+        start_point = desc.start;
+        for (size_t id = 0; id != desc.accepting.size(); id++) {
+            ba.add_vertex(id, desc.accepting[id]);
+            if (Config.is_set("--vverbose"))
+                std::cout << id << ": " << desc.accepting[id] << std::endl;
+        }
+        for (const auto& e : desc.edges) {
+            ba.add_edge(e.from, e.to, ap_translator, e.label);
+            if (Config.is_set("--vverbose"))
+                std::cout << "(" << e.from << ", " << e.to << "): " << e.label << std::endl;
+        }
+    }
+
+    index_type get_init_vert() const {
+        return start_point;
+    }
+
+    const Graph<index_type, Accepting, AP>& get_ba() {
+        return ba;
+    }
+private:
+    /**
+     * Translates formula by the built-in translator, falls back to SPOT if
+     * the formula is not supported or --spot is set
+     */
+    static BaDescription translate(const std::string& formula) {
+        if (!Config.is_set("--spot")) {
+            try {
+                return translate_ltl(formula);
+            }
+            catch (const LtlTranslateException& e) {
+                if (Config.is_set("--verbose"))
+                    std::cout << e.what() << ", falling back to ltl2tgba\n";
+            }
+        }
+        return run_spot(formula);
+    }
+
+    /**
+     * Calls SPOT tool to convert LTL formula to BA and reads its graphviz output
+     */
+    static BaDescription run_spot(const std::string& formula) {
         // Construct ba using external spot tool
         std::string query = "ltl2tgba --dot --ba -f \"" + formula + "\" 2>&1";
         FILE* pipe = popen(query.c_str(), "r");
@@ -95,10 +152,11 @@ public:
         if (!status)
             throw LtlConvException("Cannot read ltl2ba output");
 
-        // Convert BA to Graph class
         typedef typename boost::property_map<graph_t, boost::vertex_index_t>::type IndexMap;
         IndexMap index = get(boost::vertex_index, graphviz);
 
+        BaDescription desc;
+        desc.accepting.resize(boost::num_vertices(graphviz));
         auto vert = boost::vertices(graphviz);
         for (; vert.first != vert.second; vert.first++) {
             index_type id = index[*vert.first];
@@ -106,35 +164,19 @@ public:
             int count = graphviz[*vert.first].peripheries;
 
             if (label.empty()) // Initial state
-                start_point = id;
-            ba.add_vertex(id, count == 2);
-
-            if (Config.is_set("--vverbose"))
-                std::cout << id << ": " << label << ", " << count << std::endl;
+                desc.start = id;
+            desc.accepting[id] = count == 2;
         }
 
         auto edg = boost::edges(graphviz);
         for (; edg.first != edg.second; edg.first++) {
             index_type from = index[source(*edg.first, graphviz)];
             index_type to = index[target(*edg.first, graphviz)];
-            const std::string& label = graphviz[*edg.first].label;
-
-            ba.add_edge(from, to, ap_translator, label);
-
-            if (Config.is_set("--vverbose"))
-                std::cout << "(" << from << ", " << to << "): " << label << std::endl;
+            desc.edges.push_back({ from, to, graphviz[*edg.first].label });
         }
+        return desc;
     }
 
-    index_type get_init_vert() const {
-        return start_point;
-    }
-
-    const Graph<index_type, Accepting, AP>& get_ba() {
-        return ba;
-    }
-private:
-
     struct DotVertex {
         DotVertex() : peripheries(0) {}
         std::string name;
@@ -191,16 +233,16 @@ public:
     	// Try to find operator ||
     	size_t or_pos = ap.find("||");
 
-    	if (and_pos != std::string::npos) {
-        	std::string op1(ap.begin(), ap.begin() + and_pos);
-        	std::string op2(ap.begin() + 2 + and_pos, ap.end());
-        	return translate_ap(op1) && translate_ap(op2);
-    	}
-
     	if (or_pos != std::string::npos) {
         	std::string op1(ap.begin(), ap.begin() + or_pos);
         	std::string op2(ap.begin() + 2 + or_pos, ap.end());
-        	return translate_ap(op1) || translate_ap(op2);
+        	return (*this)(op1) || (*this)(op2);
+    	}
+
+    	if (and_pos != std::string::npos) {
+        	std::string op1(ap.begin(), ap.begin() + and_pos);
+        	std::string op2(ap.begin() + 2 + and_pos, ap.end());
+        	return translate_ap(op1) && (*this)(op2);
     	}
 
     	return translate_ap(ap);
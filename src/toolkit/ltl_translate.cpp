@@ -0,0 +1,492 @@
+#include <toolkit/ltl_translate.h>
+#include <toolkit/hash.h>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <tuple>
+#include <queue>
+#include <cctype>
+#include <sstream>
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * Hash-consed LTL formulas in negation normal form
+ */
+class LtlTable {
+public:
+    enum class Kind { True, False, Lit, And, Or, Until, Release };
+
+    struct Node {
+        Kind kind;
+        int ap;      // Proposition number for Lit
+        bool neg;    // Negated Lit
+        int left;
+        int right;
+    };
+
+    int make(Kind kind, int left = -1, int right = -1) {
+        if (kind == Kind::And || kind == Kind::Or) {
+            Kind unit = kind == Kind::And ? Kind::True : Kind::False;
+            Kind zero = kind == Kind::And ? Kind::False : Kind::True;
+            if (nodes[left].kind == zero || nodes[right].kind == zero)
+                return make(zero);
+            if (nodes[left].kind == unit)
+                return right;
+            if (nodes[right].kind == unit || left == right)
+                return left;
+        }
+        return intern({ kind, 0, false, left, right });
+    }
+
+    int lit(int ap, bool neg) {
+        return intern({ Kind::Lit, ap, neg, -1, -1 });
+    }
+
+    const Node& operator[](int id) const {
+        return nodes[id];
+    }
+
+private:
+    int intern(const Node& n) {
+        auto key = std::make_tuple(static_cast<int>(n.kind), n.ap, n.neg, n.left, n.right);
+        auto res = index.insert(std::make_pair(key, static_cast<int>(nodes.size())));
+        if (res.second)
+            nodes.push_back(n);
+        return res.first->second;
+    }
+
+    std::vector<Node> nodes;
+    std::map<std::tuple<int, int, bool, int, int>, int> index;
+};
+
+typedef LtlTable::Kind Kind;
+
+/**
+ * Recursive descent parser producing formulas in negation normal form. The
+ * precedence follows the LTL grammar - unary operators bind the most, then
+ * U, R, W and finally &&, ||, =>.
+ */
+class LtlParser {
+public:
+    LtlParser(const std::string& s, LtlTable& table) : s(s), pos(0), table(table) {}
+
+    int parse() {
+        int res = parse_binary(false);
+        skip();
+        if (pos != s.size())
+            error("unexpected input");
+        return res;
+    }
+
+private:
+    /**
+     * Each parse function returns the formula and its negation, so the
+     * negation normal form can be built in a single pass
+     */
+    typedef std::pair<int, int> Pair;
+
+    int parse_binary(bool negated) {
+        Pair p = binary();
+        return negated ? p.second : p.first;
+    }
+
+    Pair binary() {
+        Pair res = temporal();
+        while (true) {
+            if (accept("&&")) {
+                Pair r = temporal();
+                res = { table.make(Kind::And, res.first, r.first),
+                        table.make(Kind::Or, res.second, r.second) };
+            }
+            else if (accept("||")) {
+                Pair r = temporal();
+                res = { table.make(Kind::Or, res.first, r.first),
+                        table.make(Kind::And, res.second, r.second) };
+            }
+            else if (accept("=>")) {
+                Pair r = temporal();
+                res = { table.make(Kind::Or, res.second, r.first),
+                        table.make(Kind::And, res.first, r.second) };
+            }
+            else
+                return res;
+        }
+    }
+
+    Pair temporal() {
+        Pair res = unary();
+        while (true) {
+            if (accept("U")) {
+                Pair r = unary();
+                res = { table.make(Kind::Until, res.first, r.first),
+                        table.make(Kind::Release, res.second, r.second) };
+            }
+            else if (accept("R")) {
+                Pair r = unary();
+                res = { table.make(Kind::Release, res.first, r.first),
+                        table.make(Kind::Until, res.second, r.second) };
+            }
+            else if (accept("W")) {
+                // a W b = b R (a || b)
+                Pair r = unary();
+                res = { table.make(Kind::Release, r.first, table.make(Kind::Or, res.first, r.first)),
+                        table.make(Kind::Until, r.second, table.make(Kind::And, res.second, r.second)) };
+            }
+            else
+                return res;
+        }
+    }
+
+    Pair unary() {
+        if (accept("!")) {
+            Pair p = unary();
+            return { p.second, p.first };
+        }
+        if (accept("F")) {
+            Pair p = unary();
+            return { table.make(Kind::Until, table.make(Kind::True), p.first),
+                     table.make(Kind::Release, table.make(Kind::False), p.second) };
+        }
+        if (accept("G")) {
+            Pair p = unary();
+            return { table.make(Kind::Release, table.make(Kind::False), p.first),
+                     table.make(Kind::Until, table.make(Kind::True), p.second) };
+        }
+        if (accept("(")) {
+            Pair p = binary();
+            if (!accept(")"))
+                error("missing )");
+            return p;
+        }
+        if (accept("ap")) {
+            size_t start = pos;
+            while (pos < s.size() && isdigit(s[pos]))
+                pos++;
+            if (start == pos)
+                error("invalid atomic proposition");
+            int ap = std::stoi(s.substr(start, pos - start));
+            return { table.lit(ap, false), table.lit(ap, true) };
+        }
+        if (accept("true") || accept("1"))
+            return { table.make(Kind::True), table.make(Kind::False) };
+        if (accept("false") || accept("0"))
+            return { table.make(Kind::False), table.make(Kind::True) };
+        error("unexpected token");
+        return Pair();
+    }
+
+    void skip() {
+        while (pos < s.size() && isspace(s[pos]))
+            pos++;
+    }
+
+    bool accept(const std::string& token) {
+        skip();
+        if (s.compare(pos, token.size(), token) != 0)
+            return false;
+        // Operators F, G, U, R, W must not be a prefix of an identifier
+        if (isalpha(token.back()) && pos + token.size() < s.size()
+            && isalpha(s[pos + token.size()]))
+            return false;
+        pos += token.size();
+        return true;
+    }
+
+    void error(const std::string& msg) {
+        throw LtlTranslateException("Cannot parse LTL formula, " + msg
+            + " at position " + std::to_string(pos) + ": " + s);
+    }
+
+    const std::string& s;
+    size_t pos;
+    LtlTable& table;
+};
+
+/**
+ * Tableau construction of generalized BA (GPVW)
+ */
+class Tableau {
+public:
+    struct Node {
+        std::set<int> incoming;
+        std::set<int> fresh; // Formulas still to be processed
+        std::set<int> old;
+        std::set<int> next;
+    };
+
+    enum { INIT = -1 }; // Incoming edge from the initial state
+
+    Tableau(const LtlTable& table) : table(table) {}
+
+    void build(int formula) {
+        Node n;
+        n.incoming.insert(INIT);
+        n.fresh.insert(formula);
+        expand(n);
+    }
+
+    const std::vector<Node>& get_nodes() const {
+        return nodes;
+    }
+
+private:
+    void add(Node& n, int f) {
+        if (!n.old.count(f))
+            n.fresh.insert(f);
+    }
+
+    void expand(Node n) {
+        if (n.fresh.empty()) {
+            for (auto& nd : nodes) {
+                if (nd.old == n.old && nd.next == n.next) {
+                    nd.incoming.insert(n.incoming.begin(), n.incoming.end());
+                    return;
+                }
+            }
+            int id = nodes.size();
+            nodes.push_back(n);
+            Node succ;
+            succ.incoming.insert(id);
+            succ.fresh = n.next;
+            expand(succ);
+            return;
+        }
+
+        int f = *n.fresh.begin();
+        n.fresh.erase(n.fresh.begin());
+        const LtlTable::Node& node = table[f];
+        switch (node.kind) {
+            case Kind::False:
+                return;
+            case Kind::True:
+                n.old.insert(f);
+                expand(n);
+                return;
+            case Kind::Lit:
+                for (int o : n.old) {
+                    if (table[o].kind == Kind::Lit && table[o].ap == node.ap
+                        && table[o].neg != node.neg)
+                        return;
+                }
+                n.old.insert(f);
+                expand(n);
+                return;
+            case Kind::And:
+                n.old.insert(f);
+                add(n, node.left);
+                add(n, node.right);
+                expand(n);
+                return;
+            case Kind::Or:
+            case Kind::Until:
+            case Kind::Release: {
+                n.old.insert(f);
+                Node n2 = n;
+                if (node.kind == Kind::Or) {
+                    add(n, node.left);
+                    add(n2, node.right);
+                }
+                else if (node.kind == Kind::Until) {
+                    add(n, node.left);
+                    n.next.insert(f);
+                    add(n2, node.right);
+                }
+                else {
+                    add(n, node.right);
+                    n.next.insert(f);
+                    add(n2, node.left);
+                    add(n2, node.right);
+                }
+                expand(n);
+                expand(n2);
+                return;
+            }
+        }
+    }
+
+    const LtlTable& table;
+    std::vector<Node> nodes;
+};
+
+void collect_until(const LtlTable& table, int f, std::set<int>& res) {
+    const LtlTable::Node& n = table[f];
+    if (n.kind == Kind::Until)
+        res.insert(f);
+    if (n.left != -1)
+        collect_until(table, n.left, res);
+    if (n.right != -1)
+        collect_until(table, n.right, res);
+}
+
+std::string label(const LtlTable& table, const std::set<int>& old) {
+    std::string res;
+    for (int f : old) {
+        if (table[f].kind != Kind::Lit)
+            continue;
+        if (!res.empty())
+            res += " && ";
+        res += (table[f].neg ? "!ap" : "ap") + std::to_string(table[f].ap);
+    }
+    return res.empty() ? "1" : res;
+}
+
+} // namespace
+
+BaDescription translate_ltl(const std::string& formula) {
+    LtlTable table;
+    int f = LtlParser(formula, table).parse();
+
+    Tableau tableau(table);
+    tableau.build(f);
+    const auto& nodes = tableau.get_nodes();
+
+    // Acceptance sets of the generalized BA, one per until subformula
+    std::set<int> untils;
+    collect_until(table, f, untils);
+    std::vector<std::vector<bool>> acc_sets;
+    for (int u : untils) {
+        std::vector<bool> set(nodes.size());
+        for (size_t q = 0; q != nodes.size(); q++)
+            set[q] = !nodes[q].old.count(u) || nodes[q].old.count(table[u].right);
+        acc_sets.push_back(set);
+    }
+    if (acc_sets.empty())
+        acc_sets.push_back(std::vector<bool>(nodes.size(), true));
+    const size_t k = acc_sets.size();
+
+    // Successors and labels of tableau nodes
+    std::vector<std::vector<size_t>> succs(nodes.size());
+    std::vector<size_t> initial;
+    std::vector<std::string> labels;
+    for (size_t q = 0; q != nodes.size(); q++) {
+        for (int in : nodes[q].incoming) {
+            if (in == Tableau::INIT)
+                initial.push_back(q);
+            else
+                succs[in].push_back(q);
+        }
+        labels.push_back(label(table, nodes[q].old));
+    }
+
+    // Degeneralization - vertex (q, i) waits for the acceptance set i
+    BaDescription ba;
+    ba.start = 0;
+    ba.accepting = { false, false }; // Start vertex and the initial state
+    ba.edges.push_back({ 0, 1, "1" });
+
+    std::map<std::pair<size_t, size_t>, size_t> index;
+    std::queue<std::pair<size_t, size_t>> to_do;
+    auto get_vertex = [&](size_t q, size_t i) {
+        auto res = index.insert(std::make_pair(std::make_pair(q, i), ba.accepting.size()));
+        if (res.second) {
+            ba.accepting.push_back(i == k - 1 && acc_sets[i][q]);
+            to_do.push(std::make_pair(q, i));
+        }
+        return res.first->second;
+    };
+
+    for (size_t q : initial)
+        ba.edges.push_back({ 1, get_vertex(q, 0), labels[q] });
+
+    while (!to_do.empty()) {
+        size_t q = to_do.front().first;
+        size_t i = to_do.front().second;
+        to_do.pop();
+        size_t from = index[std::make_pair(q, i)];
+        size_t j = acc_sets[i][q] ? (i + 1) % k : i;
+        for (size_t s : succs[q])
+            ba.edges.push_back({ from, get_vertex(s, j), labels[s] });
+    }
+
+    return ba;
+}
+
+void BaDescription::save(std::ostream& o) const {
+    o << start << " " << accepting.size() << " " << edges.size() << "\n";
+    for (bool acc : accepting)
+        o << acc << "\n";
+    for (const auto& e : edges)
+        o << e.from << " " << e.to << " " << e.label << "\n";
+    o << "end\n";
+}
+
+bool BaDescription::load(std::istream& i) {
+    size_t vertices, edge_count;
+    if (!(i >> start >> vertices >> edge_count))
+        return false;
+    accepting.clear();
+    for (size_t v = 0; v != vertices; v++) {
+        bool acc;
+        if (!(i >> acc))
+            return false;
+        accepting.push_back(acc);
+    }
+    edges.clear();
+    for (size_t e = 0; e != edge_count; e++) {
+        Edge edge;
+        if (!(i >> edge.from >> edge.to) || !std::getline(i >> std::ws, edge.label))
+            return false;
+        if (edge.from >= vertices || edge.to >= vertices)
+            return false;
+        edges.push_back(edge);
+    }
+    // Detects truncated input, the last label could be cut otherwise
+    std::string end;
+    return (i >> end) && end == "end";
+}
+
+/**
+ * Cache file name is derived from hash of the key, the key itself is stored
+ * on the first line of the file to detect collisions. The key is the formula
+ * prefixed by the translator, so automata by SPOT and by the built-in
+ * translator are cached separately.
+ */
+static std::string cache_key(const std::string& formula, bool spot) {
+    return (spot ? "spot: " : "gpvw: ") + formula;
+}
+
+static std::string cache_file(const std::string& dir, const std::string& key) {
+    hash128_t h = spookyHash(key.data(), key.size(), 0, 0);
+    std::ostringstream name;
+    name << dir << "/" << std::hex << std::setfill('0') << std::setw(16) << h.first
+         << std::setw(16) << h.second << ".ba";
+    return name.str();
+}
+
+bool load_cached_ba(const std::string& dir, const std::string& formula,
+    bool spot, BaDescription& ba)
+{
+    std::string key = cache_key(formula, spot);
+    std::ifstream in(cache_file(dir, key));
+    std::string cached_key;
+    if (!in || !std::getline(in, cached_key) || cached_key != key)
+        return false;
+    return ba.load(in);
+}
+
+void store_cached_ba(const std::string& dir, const std::string& formula,
+    bool spot, const BaDescription& ba)
+{
+    // Concurrent runs may share the cache, so the file is written under
+    // a private name and renamed atomically
+    std::string key = cache_key(formula, spot);
+    std::string file = cache_file(dir, key);
+    std::string tmp = file + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out)
+            return;
+        out << key << "\n";
+        ba.save(out);
+        if (!out.flush()) {
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), file.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * Built-in translation of LTL formulas to Buchi automata. Supports formulas in
+ * the form produced by the LTL parser (atomic propositions ap1, ap2, ...,
+ * boolean operators !, &&, ||, => and temporal operators F, G, U, R, W).
+ *
+ * The formula is converted to negation normal form, translated to generalized
+ * BA by the tableau construction of Gerth, Peled, Vardi and Wolper and then
+ * degeneralized.
+ */
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+/**
+ * Buchi automaton with edges labeled by guards in the form accepted by the AP
+ * translator of Ltl2ba (conjunctions of possibly negated propositions, "1"
+ * for true). The start vertex has single edge to the initial state.
+ */
+struct BaDescription {
+    struct Edge {
+        size_t from;
+        size_t to;
+        std::string label;
+    };
+
+    size_t start;
+    std::vector<bool> accepting; // Indexed by vertex
+    std::vector<Edge> edges;
+
+    void save(std::ostream& o) const;
+
+    /**
+     * Loads automaton written by save
+     * @return false if the input is malformed
+     */
+    bool load(std::istream& i);
+};
+
+class LtlTranslateException : public std::runtime_error {
+public:
+    LtlTranslateException(const std::string& msg) : std::runtime_error(msg) { }
+};
+
+/**
+ * Translates given formula to BA, throws LtlTranslateException for formulas
+ * outside the supported fragment
+ */
+BaDescription translate_ltl(const std::string& formula);
+
+/**
+ * Looks up automaton for given formula and translator (SPOT or built-in) in
+ * the cache directory
+ * @return true if the automaton was found
+ */
+bool load_cached_ba(const std::string& dir, const std::string& formula,
+    bool spot, BaDescription& ba);
+
+/**
+ * Stores automaton for given formula and translator to the cache directory,
+ * failures are silently ignored
+ */
+void store_cached_ba(const std::string& dir, const std::string& formula,
+    bool spot, const BaDescription& ba);
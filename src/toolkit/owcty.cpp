@@ -0,0 +1,202 @@
+#include <toolkit/owcty.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cassert>
+
+Owcty::Owcty(const CsrGraph& graph, const std::vector<bool>& accepting,
+    unsigned threads)
+    : graph(graph), accepting(accepting), threads(threads), iteration_count(0),
+      level(nullptr), level_count(0), running(0), stopping(false)
+{
+    assert(accepting.size() == vertex_count());
+    if (this->threads == 0)
+        this->threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+Owcty::~Owcty() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (auto& w : workers)
+        w.join();
+}
+
+template <class F>
+void Owcty::parallel_for(size_t n, F f) {
+    // Small levels are not worth waking the workers
+    if (threads == 1 || n < 1024) {
+        f(0, n, 0);
+        return;
+    }
+
+    size_t part = (n + threads - 1) / threads;
+    run_level([&](unsigned i) {
+        size_t begin = std::min(n, i * part);
+        size_t end = std::min(n, begin + part);
+        f(begin, end, i);
+    });
+}
+
+void Owcty::run_level(const std::function<void(unsigned)>& part) {
+    if (workers.empty()) {
+        for (unsigned i = 1; i != threads; i++)
+            workers.emplace_back(&Owcty::work, this, i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        level = &part;
+        running = threads - 1;
+        level_count++;
+    }
+    started.notify_all();
+    part(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return running == 0; });
+    level = nullptr;
+}
+
+void Owcty::work(unsigned index) {
+    size_t done = 0;
+    while (true) {
+        const std::function<void(unsigned)>* part;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&] { return stopping || level_count != done; });
+            if (stopping)
+                return;
+            done = level_count;
+            part = level;
+        }
+        (*part)(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0)
+            finished.notify_one();
+    }
+}
+
+std::vector<size_t> Owcty::reach(const std::vector<size_t>& seeds,
+    std::vector<char>& in_set)
+{
+    std::vector<std::atomic<char>> visited(vertex_count());
+    for (auto& v : visited)
+        v.store(0, std::memory_order_relaxed);
+
+    std::vector<size_t> result;
+    std::vector<size_t> frontier;
+    for (size_t s : seeds) {
+        if (in_set[s] && !visited[s].exchange(1))
+            frontier.push_back(s);
+    }
+
+    std::vector<std::vector<size_t>> next(threads);
+    while (!frontier.empty()) {
+        result.insert(result.end(), frontier.begin(), frontier.end());
+        parallel_for(frontier.size(), [&](size_t begin, size_t end, unsigned t) {
+            for (size_t i = begin; i != end; i++) {
+                auto succs = graph.get_successors(frontier[i]);
+                for (; succs.first != succs.second; ++succs.first) {
+                    size_t succ = *succs.first;
+                    if (in_set[succ] && !visited[succ].exchange(1))
+                        next[t].push_back(succ);
+                }
+            }
+        });
+
+        frontier.clear();
+        for (auto& n : next) {
+            frontier.insert(frontier.end(), n.begin(), n.end());
+            n.clear();
+        }
+    }
+
+    for (size_t v = 0; v != vertex_count(); v++)
+        in_set[v] = visited[v].load(std::memory_order_relaxed);
+    return result;
+}
+
+size_t Owcty::eliminate(const std::vector<size_t>& vertices, std::vector<char>& in_set) {
+    const std::vector<char> member = in_set;
+    std::vector<std::atomic<size_t>> indegree(vertex_count());
+    for (auto& d : indegree)
+        d.store(0, std::memory_order_relaxed);
+
+    parallel_for(vertices.size(), [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i != end; i++) {
+            auto succs = graph.get_successors(vertices[i]);
+            for (; succs.first != succs.second; ++succs.first) {
+                if (member[*succs.first])
+                    indegree[*succs.first]++;
+            }
+        }
+    });
+
+    std::vector<size_t> frontier;
+    for (size_t v : vertices) {
+        if (indegree[v] == 0)
+            frontier.push_back(v);
+    }
+
+    size_t removed = 0;
+    std::vector<std::vector<size_t>> next(threads);
+    while (!frontier.empty()) {
+        removed += frontier.size();
+        parallel_for(frontier.size(), [&](size_t begin, size_t end, unsigned t) {
+            for (size_t i = begin; i != end; i++) {
+                size_t v = frontier[i];
+                in_set[v] = 0;
+                auto succs = graph.get_successors(v);
+                for (; succs.first != succs.second; ++succs.first) {
+                    size_t succ = *succs.first;
+                    if (member[succ] && --indegree[succ] == 0)
+                        next[t].push_back(succ);
+                }
+            }
+        });
+
+        frontier.clear();
+        for (auto& n : next) {
+            frontier.insert(frontier.end(), n.begin(), n.end());
+            n.clear();
+        }
+    }
+
+    return vertices.size() - removed;
+}
+
+bool Owcty::run(size_t initial) {
+    assert(initial < vertex_count());
+    iteration_count = 0;
+
+    std::vector<char> in_set(vertex_count(), 1);
+    std::vector<size_t> set = reach({ initial }, in_set);
+    size_t size = set.size();
+
+    while (true) {
+        iteration_count++;
+        std::vector<size_t> seeds;
+        for (size_t v : set) {
+            if (accepting[v])
+                seeds.push_back(v);
+        }
+        set = reach(seeds, in_set);
+        size_t remaining = eliminate(set, in_set);
+        if (remaining == 0)
+            return false;
+        if (remaining == size)
+            return true;
+
+        size = remaining;
+        std::vector<size_t> kept;
+        for (size_t v : set) {
+            if (in_set[v])
+                kept.push_back(v);
+        }
+        set.swap(kept);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+ * Parallel accepting cycle detection using the OWCTY (One Way Catch Them
+ * Young) algorithm. Works on an explicit graph given in compressed sparse row
+ * form by CsrGraph, every vertex of the graph has to be expanded.
+ *
+ * The algorithm repeats two phases until a fixpoint is reached:
+ *  - reset: keep only the vertices reachable from accepting vertices of the set
+ *  - elimination: remove the vertices without predecessors in the set
+ * An accepting cycle exists iff the resulting set is non-empty. Both phases are
+ * level-synchronous, every level is split among the worker threads. The
+ * workers are started by the first level large enough and wait for the next
+ * levels until the detector is destroyed.
+ */
+
+#include <vector>
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "csr_graph.h"
+
+class Owcty {
+public:
+    /**
+     * @param threads number of worker threads, 0 means hardware concurrency
+     */
+    Owcty(const CsrGraph& graph, const std::vector<bool>& accepting,
+        unsigned threads = 0);
+    ~Owcty();
+
+    Owcty(const Owcty&) = delete;
+    Owcty& operator=(const Owcty&) = delete;
+
+    /**
+     * Runs the detection from given initial vertex
+     * @return true if an accepting cycle is reachable
+     */
+    bool run(size_t initial);
+
+    /**
+     * Returns number of iterations of the last run
+     */
+    size_t iterations() const {
+        return iteration_count;
+    }
+
+private:
+    size_t vertex_count() const {
+        return graph.vertex_count();
+    }
+
+    /**
+     * Marks all vertices in the set reachable from given seeds and returns
+     * them. Vertices outside the set are ignored.
+     */
+    std::vector<size_t> reach(const std::vector<size_t>& seeds,
+        std::vector<char>& in_set);
+
+    /**
+     * Removes vertices without predecessors from the set
+     * @return number of remaining vertices
+     */
+    size_t eliminate(const std::vector<size_t>& vertices, std::vector<char>& in_set);
+
+    /**
+     * Calls f(begin, end, thread_index) in parallel on the parts of [0, n)
+     */
+    template <class F>
+    void parallel_for(size_t n, F f);
+
+    /**
+     * Calls part(i) for every thread index i, the calling thread takes
+     * index 0 and the workers the others
+     */
+    void run_level(const std::function<void(unsigned)>& part);
+
+    /**
+     * Main loop of the worker with given thread index
+     */
+    void work(unsigned index);
+
+    const CsrGraph& graph;
+    const std::vector<bool>& accepting;
+    unsigned threads;
+    size_t iteration_count;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable started;  // A level was handed to the workers
+    std::condition_variable finished; // All workers finished the level
+    const std::function<void(unsigned)>* level; // Level being processed
+    size_t level_count; // Number of levels handed to the workers
+    unsigned running;   // Workers still processing the level
+    bool stopping;
+};
@@ -6,8 +6,10 @@
  */
 
 #include <unordered_map>
+#include <list>
 #include <stdexcept>
 #include <iostream>
+#include <string>
 
 struct ResInfo;
 
@@ -18,8 +20,9 @@ struct StatInfo {
     size_t hit_count;
     size_t miss_count;
     size_t replace_count;
+    size_t evict_count;
 
-    StatInfo() : hit_count(0), miss_count(0), replace_count(0) {}
+    StatInfo() : hit_count(0), miss_count(0), replace_count(0), evict_count(0) {}
 };
 
 /**
@@ -30,7 +33,16 @@ struct StatInfo {
 template <class Query, class Result, class SInfo = ResInfo>
 class QueryCache {
 public:
-    QueryCache() {}
+    QueryCache() : capacity(0) {}
+
+    /**
+     * Limits the number of cached queries, the least recently used ones are
+     * evicted. 0 means no limit.
+     */
+    void set_capacity(size_t items) {
+        capacity = items;
+        evict();
+    }
 
     /**
      * Checks if given query is cached
@@ -47,6 +59,8 @@ public:
             last_cached = true;
             r->second.second.access();
             last_res = &r->second.first;
+            if (capacity != 0)
+                lru.splice(lru.begin(), lru, r->second.lru_pos);
         }
         return last_cached;
     }
@@ -67,9 +81,14 @@ public:
      */
     template <typename... Args>
     void place(const Query& q, const Result& r, Args&&... args) {
-        if (cache.find(q) != cache.end())
+        auto res = cache.find(q);
+        if (res != cache.end()) {
             s_info.replace_count++;
-        cache[q] = std::make_pair(r, SInfo(args...));
+            res->second.first = r;
+            res->second.second = SInfo(args...);
+            return;
+        }
+        insert(q, r, SInfo(args...));
     }
 
     /**
@@ -82,12 +101,23 @@ public:
     /**
      * Dumps statistic info to given stream
      */
-    void dump_stat(std::ostream& s) {
-        s << "Query cache statistics" << std::endl;
-        s << "----------------------" << std::endl;
+    void dump_stat(std::ostream& s, const std::string& title = "Query cache statistics") {
+        s << title << std::endl;
+        s << std::string(title.size(), '-') << std::endl;
         s << "Hit count:     " << s_info.hit_count << std::endl;
         s << "Miss count:    " << s_info.miss_count << std::endl;
         s << "Replace count: " << s_info.replace_count << std::endl;
+        if (capacity != 0)
+            s << "Evict count:   " << s_info.evict_count << std::endl;
+    }
+
+    /**
+     * Forgets all cached items, the statistics are kept
+     */
+    void clear() {
+        cache.clear();
+        lru.clear();
+        last_cached = false;
     }
 
     /**
@@ -98,13 +128,74 @@ public:
         for (const auto& item : cache)
             f(item.first, item.second.first, item.second.second);
     }
+    /**
+     * Serializes cached queries with their results and statistics
+     */
+    template <class Writer>
+    void save(Writer& w) const {
+        w.write(cache.size());
+        for (const auto& item : cache) {
+            w.write(item.first);
+            w.write(item.second.first);
+            w.write(item.second.second);
+        }
+    }
+
+    template <class Reader>
+    void load(Reader& r) {
+        size_t size;
+        r.read(size);
+        for (size_t i = 0; i != size; i++) {
+            Query q;
+            Result res;
+            SInfo info;
+            r.read(q);
+            r.read(res);
+            r.read(info);
+            if (cache.find(q) == cache.end())
+                insert(q, res, info);
+        }
+    }
+
 private:
+    /**
+     * Cached result with its statistics and position in the LRU list
+     */
+    struct Item {
+        Result first;
+        SInfo second;
+        typename std::list<const Query*>::iterator lru_pos;
+    };
+
+    void insert(const Query& q, const Result& r, const SInfo& info) {
+        auto res = cache.insert(std::make_pair(q, Item{ r, info, lru.end() })).first;
+        if (capacity != 0) {
+            // Keys of unordered_map are not moved by rehashing
+            lru.push_front(&res->first);
+            res->second.lru_pos = lru.begin();
+            evict();
+        }
+    }
+
+    void evict() {
+        while (capacity != 0 && cache.size() > capacity) {
+            auto res = cache.find(*lru.back());
+            if (last_cached && last_res == &res->second.first)
+                last_cached = false;
+            lru.pop_back();
+            cache.erase(res);
+            s_info.evict_count++;
+        }
+    }
+
     bool last_cached;
     const Result* last_res;
 
     StatInfo s_info;
 
-    std::unordered_map<Query, std::pair<Result, SInfo>> cache;
+    size_t capacity;
+    std::list<const Query*> lru; // Cached queries, the most recently used first
+    std::unordered_map<Query, Item> cache;
 };
 
 /**
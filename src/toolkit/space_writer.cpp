@@ -0,0 +1,101 @@
+#include <toolkit/space_writer.h>
+
+SpaceWriter::SpaceWriter(const std::string& filename, const std::string& kind)
+    : closing(false)
+{
+    if (filename.empty())
+        return;
+
+    out.open(filename, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw SpaceWriterException("Cannot open " + filename);
+    out << "SymDIVINE space v1 " << kind << "\n";
+    buffer.reserve(buffer_size);
+    worker = std::thread(&SpaceWriter::write_loop, this);
+}
+
+SpaceWriter::~SpaceWriter() {
+    close();
+}
+
+void SpaceWriter::vertex(uint64_t exp_id, uint64_t sym_id, uint32_t group,
+    const std::string& label)
+{
+    if (!enabled())
+        return;
+    put('V');
+    put(exp_id);
+    put(sym_id);
+    put(group);
+    put(static_cast<uint32_t>(label.size()));
+    buffer.append(label);
+    if (buffer.size() >= buffer_size)
+        flush();
+}
+
+void SpaceWriter::edge(uint64_t from_exp, uint64_t from_sym, uint64_t to_exp,
+    uint64_t to_sym)
+{
+    if (!enabled())
+        return;
+    put('E');
+    put(from_exp);
+    put(from_sym);
+    put(to_exp);
+    put(to_sym);
+    if (buffer.size() >= buffer_size)
+        flush();
+}
+
+void SpaceWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return pending.size() < max_pending; });
+    pending.push_back(std::move(buffer));
+    buffer.clear();
+    buffer.reserve(buffer_size);
+    changed.notify_all();
+}
+
+void SpaceWriter::close() {
+    if (!enabled())
+        return;
+    resume();
+    if (!buffer.empty())
+        flush();
+    suspend();
+    out.close();
+}
+
+void SpaceWriter::suspend() {
+    if (!worker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+        changed.notify_all();
+    }
+    worker.join();
+}
+
+void SpaceWriter::resume() {
+    if (!enabled() || worker.joinable())
+        return;
+    closing = false;
+    worker = std::thread(&SpaceWriter::write_loop, this);
+}
+
+void SpaceWriter::write_loop() {
+    while (true) {
+        std::string data;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return closing || !pending.empty(); });
+            if (pending.empty())
+                return;
+            data = std::move(pending.front());
+            pending.pop_front();
+            changed.notify_all();
+        }
+        out.write(data.data(), data.size());
+    }
+}
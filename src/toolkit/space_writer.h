@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * Streaming export of the state space. Vertices and edges are written during
+ * the exploration in a binary format, so the state space does not have to be
+ * traversed again and no large strings are built. Records are collected in
+ * buffers which are written to the file by a background thread. The number of
+ * buffers waiting for the write is bounded, so the memory usage does not grow
+ * with the size of the state space.
+ *
+ * Format: header line "SymDIVINE space v1 <kind>" followed by records
+ *   'V' id group label_size label - vertex with optional label
+ *   'E' id id                     - edge
+ * where id is a pair of 64-bit numbers, group and label_size are 32-bit
+ * numbers, all in native byte order. A vertex or an edge may occur multiple
+ * times. Use scripts/convert_space.py to convert the file to DOT or GraphML.
+ */
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+class SpaceWriterException : public std::runtime_error {
+public:
+    SpaceWriterException(const std::string& msg) : std::runtime_error(msg) { }
+};
+
+class SpaceWriter {
+public:
+    /**
+     * Creates disabled writer if filename is empty
+     * @param kind type of the state space (reachability, ltl)
+     */
+    SpaceWriter(const std::string& filename = "", const std::string& kind = "");
+    ~SpaceWriter();
+
+    SpaceWriter(const SpaceWriter&) = delete;
+    SpaceWriter& operator=(const SpaceWriter&) = delete;
+
+    bool enabled() const {
+        return out.is_open();
+    }
+
+    void vertex(uint64_t exp_id, uint64_t sym_id, uint32_t group,
+        const std::string& label = "");
+
+    void edge(uint64_t from_exp, uint64_t from_sym, uint64_t to_exp,
+        uint64_t to_sym);
+
+    /**
+     * Writes all pending records and closes the file
+     */
+    void close();
+
+    /**
+     * Stops the writer thread until resume is called, e.g. to fork the
+     * process. Records are still collected in the current buffer.
+     */
+    void suspend();
+    void resume();
+
+private:
+    template <class T>
+    void put(const T& v) {
+        buffer.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    /**
+     * Hands the current buffer over to the writer thread, blocks while too
+     * many buffers are waiting
+     */
+    void flush();
+    void write_loop();
+
+    static const size_t buffer_size = 1 << 20;
+    static const size_t max_pending = 4;
+
+    std::ofstream out;
+    std::string buffer;
+    std::deque<std::string> pending;
+    bool closing;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread worker;
+};
@@ -0,0 +1,71 @@
+#include <toolkit/state_corpus.h>
+
+namespace {
+    const std::string header = "SymDIVINE corpus v1 ";
+
+    template <class T>
+    void put(std::ostream& o, const T& v) {
+        o.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template <class T>
+    bool get(std::istream& i, T& v) {
+        return bool(i.read(reinterpret_cast<char*>(&v), sizeof(T)));
+    }
+}
+
+StateCorpusWriter::StateCorpusWriter(const std::string& filename,
+    const std::string& store)
+{
+    if (filename.empty())
+        return;
+    out.open(filename, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw StateCorpusException("Cannot open " + filename);
+    out << header << store << "\n";
+}
+
+void StateCorpusWriter::write(const char* data, uint64_t size, uint64_t user_size,
+    uint64_t explicit_size, const std::vector<size_t>& chunks)
+{
+    put(out, user_size);
+    put(out, explicit_size);
+    put(out, uint64_t(chunks.size()));
+    for (size_t c : chunks)
+        put(out, uint64_t(c));
+    put(out, size);
+    out.write(data, size);
+}
+
+std::vector<CorpusState> read_corpus(const std::string& filename, std::string& store) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        throw StateCorpusException("Cannot read " + filename);
+    std::string line;
+    std::getline(in, line);
+    if (line.compare(0, header.size(), header) != 0)
+        throw StateCorpusException(filename + " is not a state corpus");
+    store = line.substr(header.size());
+
+    std::vector<CorpusState> res;
+    CorpusState st;
+    while (get(in, st.user_size)) {
+        uint64_t count, size;
+        if (!get(in, st.explicit_size) || !get(in, count))
+            throw StateCorpusException("Truncated corpus " + filename);
+        st.chunks.resize(count);
+        for (auto& c : st.chunks) {
+            uint64_t v;
+            if (!get(in, v))
+                throw StateCorpusException("Truncated corpus " + filename);
+            c = v;
+        }
+        if (!get(in, size))
+            throw StateCorpusException("Truncated corpus " + filename);
+        st.data.resize(size);
+        if (!in.read(&st.data[0], size))
+            throw StateCorpusException("Truncated corpus " + filename);
+        res.push_back(st);
+    }
+    return res;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Corpus of serialized states captured from a real run (--capture-states).
+ * It is the input of symdivine_bench, so the kernels are measured on
+ * realistic data and the measurements are reproducible.
+ *
+ * Format: header line "SymDIVINE corpus v1 <store>" followed by records
+ *   user_size explicit_size chunk_count chunk_sizes... size data
+ * where all numbers are 64-bit in native byte order and data is the whole
+ * state blob (user, explicit and symbolic part). The store is either full or
+ * partial, the symbolic parts can be read only by the same store.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <stdexcept>
+
+class StateCorpusException : public std::runtime_error {
+public:
+    StateCorpusException(const std::string& msg) : std::runtime_error(msg) { }
+};
+
+struct CorpusState {
+    uint64_t user_size;
+    uint64_t explicit_size;
+    std::vector<size_t> chunks; // See Evaluator::getExplicitChunks
+    std::string data;
+};
+
+class StateCorpusWriter {
+public:
+    /**
+     * Creates disabled writer if filename is empty
+     */
+    StateCorpusWriter(const std::string& filename, const std::string& store);
+
+    bool enabled() const {
+        return out.is_open();
+    }
+
+    template <class State>
+    void state(const State& st, const std::vector<size_t>& chunks) {
+        if (!enabled())
+            return;
+        write(st.getUser(), st.getUserSize() + st.getExplSize() + st.getSymbSize(),
+            st.getUserSize(), st.getExplSize(), chunks);
+    }
+
+private:
+    void write(const char* data, uint64_t size, uint64_t user_size,
+        uint64_t explicit_size, const std::vector<size_t>& chunks);
+
+    std::ofstream out;
+};
+
+/**
+ * Reads the whole corpus into memory
+ * @param store filled with the store the corpus was captured with
+ */
+std::vector<CorpusState> read_corpus(const std::string& filename, std::string& store);
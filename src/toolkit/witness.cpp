@@ -0,0 +1,202 @@
+#include <toolkit/witness.h>
+#include <cstdint>
+#include <cstdio>
+
+namespace {
+    const char* witness_keys =
+        "  <key attr.name=\"nodeType\" attr.type=\"string\" for=\"node\" id=\"nodetype\">\n"
+        "    <default>path</default>\n"
+        "  </key>\n"
+        "  <key attr.name=\"isViolationNode\" attr.type=\"boolean\" for=\"node\" id=\"violation\">\n"
+        "    <default>false</default>\n"
+        "  </key>\n"
+        "  <key attr.name=\"isEntryNode\" attr.type=\"boolean\" for=\"node\" id=\"entry\">\n"
+        "    <default>false</default>\n"
+        "  </key>\n"
+        "  <key attr.name=\"sourcecodeLanguage\" attr.type=\"string\" for=\"graph\" id=\"sourcecodelang\"/>\n"
+        "  <key attr.name=\"programFile\" attr.type=\"string\" for=\"graph\" id=\"programfile\"/>\n"
+        "  <key attr.name=\"specification\" attr.type=\"string\" for=\"graph\" id=\"specification\"/>\n"
+        "  <key attr.name=\"memoryModel\" attr.type=\"string\" for=\"graph\" id=\"memorymodel\"/>\n"
+        "  <key attr.name=\"architecture\" attr.type=\"string\" for=\"graph\" id=\"architecture\"/>\n"
+        "  <key attr.name=\"producer\" attr.type=\"string\" for=\"graph\" id=\"producer\"/>\n"
+        "  <key attr.name=\"programhash\" attr.type=\"string\" for=\"graph\" id=\"programhash\"/>\n"
+        "  <key attr.name=\"startline\" attr.type=\"int\" for=\"edge\" id=\"startline\"/>\n"
+        "  <key attr.name=\"threadId\" attr.type=\"string\" for=\"edge\" id=\"threadId\"/>\n"
+        "  <key attr.name=\"witness-type\" attr.type=\"string\" for=\"graph\" id=\"witness-type\"/>\n";
+
+    std::string xml_escape(const std::string& s) {
+        std::string res;
+        for (char c : s) {
+            switch (c) {
+                case '<': res += "&lt;"; break;
+                case '>': res += "&gt;"; break;
+                case '&': res += "&amp;"; break;
+                case '"': res += "&quot;"; break;
+                default: res += c;
+            }
+        }
+        return res;
+    }
+
+    uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void sha1_block(uint32_t h[5], const unsigned char* block) {
+        uint32_t w[80];
+        for (int i = 0; i != 16; i++) {
+            w[i] = uint32_t(block[4 * i]) << 24 | uint32_t(block[4 * i + 1]) << 16
+                | uint32_t(block[4 * i + 2]) << 8 | uint32_t(block[4 * i + 3]);
+        }
+        for (int i = 16; i != 80; i++)
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i != 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+}
+
+std::string sha1_file(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        throw WitnessException("Cannot read " + filename);
+
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    unsigned char block[64];
+    uint64_t length = 0;
+    while (true) {
+        in.read(reinterpret_cast<char*>(block), 64);
+        size_t got = in.gcount();
+        length += got;
+        if (got == 64) {
+            sha1_block(h, block);
+            continue;
+        }
+
+        // Padding: 0x80, zeros and the message length in bits
+        block[got++] = 0x80;
+        if (got > 56) {
+            while (got != 64)
+                block[got++] = 0;
+            sha1_block(h, block);
+            got = 0;
+        }
+        while (got != 56)
+            block[got++] = 0;
+        for (int i = 0; i != 8; i++)
+            block[56 + i] = (length * 8) >> (56 - 8 * i);
+        sha1_block(h, block);
+        break;
+    }
+
+    char hex[41];
+    for (int i = 0; i != 5; i++)
+        snprintf(hex + 8 * i, 9, "%08x", h[i]);
+    return hex;
+}
+
+WitnessWriter::WitnessWriter(const std::string& filename, bool violation,
+    const std::string& program, const std::string& arch)
+    : filename(filename), violation(violation), node_count(1)
+{
+    if (filename.empty())
+        return;
+
+    std::string hash = program.empty() ? "" : sha1_file(program);
+    out.open(filename + ".tmp", std::ios::trunc);
+    if (!out)
+        throw WitnessException("Cannot open " + filename + ".tmp");
+
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+        << "<graphml xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+           "xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+        << witness_keys
+        << "  <graph edgedefault=\"directed\">\n"
+        << "    <data key=\"witness-type\">"
+        << (violation ? "violation_witness" : "correctness_witness") << "</data>\n"
+        << "    <data key=\"sourcecodelang\">C</data>\n"
+        << "    <data key=\"producer\">SymDIVINE</data>\n"
+        << "    <data key=\"specification\">CHECK( init(main()), LTL(G ! call(__VERIFIER_error())) )</data>\n"
+        << "    <data key=\"programfile\">" << xml_escape(program) << "</data>\n"
+        << "    <data key=\"memorymodel\">precise</data>\n"
+        << "    <data key=\"programhash\">" << hash << "</data>\n"
+        << "    <data key=\"architecture\">" << xml_escape(arch) << "</data>\n";
+}
+
+WitnessWriter::~WitnessWriter() {
+    discard();
+}
+
+void WitnessWriter::step(unsigned line, int thread) {
+    if (!enabled() || !violation)
+        return;
+    out << "    <edge source=\"N" << node_count - 1 << "\" target=\"N" << node_count << "\">\n";
+    if (line != 0)
+        out << "      <data key=\"startline\">" << line << "</data>\n";
+    out << "      <data key=\"threadId\">" << thread << "</data>\n"
+        << "    </edge>\n";
+    node_count++;
+}
+
+void WitnessWriter::close() {
+    if (!enabled())
+        return;
+
+    // Edges refer to the nodes by id, so the nodes can be written last and
+    // the path does not have to be kept
+    if (violation && node_count == 1)
+        step(0, 0);
+    for (size_t i = 0; i != node_count; i++) {
+        out << "    <node id=\"N" << i << "\"";
+        if (i == 0)
+            out << ">\n      <data key=\"entry\">true</data>\n    </node>\n";
+        else if (i == node_count - 1 && violation)
+            out << ">\n      <data key=\"violation\">true</data>\n    </node>\n";
+        else
+            out << "/>\n";
+    }
+    out << "  </graph>\n</graphml>\n";
+    out.close();
+
+    std::string tmp = filename + ".tmp";
+    if (!out || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw WitnessException("Cannot write " + filename);
+    }
+}
+
+void WitnessWriter::discard() {
+    if (!enabled())
+        return;
+    out.close();
+    std::remove((filename + ".tmp").c_str());
+}
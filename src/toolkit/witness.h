@@ -0,0 +1,66 @@
+#pragma once
+
+/**
+ * Writes SV-COMP witnesses in GraphML format. A violation witness is a path
+ * from the entry node to the violation node, its edges are annotated with
+ * source lines and threads. A correctness witness consists only of the entry
+ * node. The witness is streamed, so the path is never kept in memory. It is
+ * written to a temporary file which replaces the witness file only when the
+ * witness is closed, a writer destroyed before that leaves no witness.
+ */
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+
+class WitnessException : public std::runtime_error {
+public:
+    WitnessException(const std::string& msg) : std::runtime_error(msg) { }
+};
+
+class WitnessWriter {
+public:
+    /**
+     * Creates disabled writer if filename is empty
+     * @param program verified source file, its hash is stored in the witness
+     * @param arch architecture, e.g. 32bit
+     */
+    WitnessWriter(const std::string& filename, bool violation,
+        const std::string& program, const std::string& arch);
+    ~WitnessWriter();
+
+    WitnessWriter(const WitnessWriter&) = delete;
+    WitnessWriter& operator=(const WitnessWriter&) = delete;
+
+    bool enabled() const {
+        return out.is_open();
+    }
+
+    /**
+     * Appends a step of the violating path
+     * @param line source line of the step, 0 if unknown
+     * @param thread thread performing the step
+     */
+    void step(unsigned line, int thread);
+
+    /**
+     * Finishes the witness, the last node of the path is the violation node
+     */
+    void close();
+
+    /**
+     * Drops the unfinished witness
+     */
+    void discard();
+
+private:
+    std::string filename;
+    std::ofstream out;
+    bool violation;
+    size_t node_count;
+};
+
+/**
+ * Returns SHA-1 hash of given file as a hex string
+ */
+std::string sha1_file(const std::string& filename);
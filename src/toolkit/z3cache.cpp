@@ -1,3 +1,4 @@
 #include <toolkit/z3cache.h>
 
-QueryCache<Z3SubsetCall, z3::check_result, Z3Info> Z3cache;
\ No newline at end of file
+QueryCache<Z3SubsetCall, z3::check_result, Z3Info> Z3cache;
+QueryCache<llvm_sym::Formula, llvm_sym::Formula> SimplifyCache;
\ No newline at end of file
@@ -38,6 +38,20 @@ struct Z3SubsetCall {
     std::vector<llvm_sym::Formula> pc_a;   // Path condition (including defs) for state a
     std::vector<llvm_sym::Formula> pc_b;   // Path condition (including defs) for state b
     std::vector<std::pair<llvm_sym::Formula::Ident, llvm_sym::Formula::Ident>> distinct; // distinct variables
+
+    template <class Writer>
+    void save(Writer& w) const {
+        w.write(pc_a);
+        w.write(pc_b);
+        w.write(distinct);
+    }
+
+    template <class Reader>
+    void load(Reader& r) {
+        r.read(pc_a);
+        r.read(pc_b);
+        r.read(distinct);
+    }
 };
 
 namespace std {
@@ -82,4 +96,10 @@ namespace std {
 /**
  * Global instance of single z3 query cache
  */
-extern QueryCache<Z3SubsetCall, z3::check_result, Z3Info> Z3cache;
\ No newline at end of file
+extern QueryCache<Z3SubsetCall, z3::check_result, Z3Info> Z3cache;
+
+/**
+ * Global cache of formulas simplified by llvm_sym::simplify, bounded by
+ * --simplify-cache as it is keyed by whole path conditions
+ */
+extern QueryCache<llvm_sym::Formula, llvm_sym::Formula> SimplifyCache;
\ No newline at end of file
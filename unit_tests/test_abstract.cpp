@@ -0,0 +1,246 @@
+#include <catch/catch.hpp>
+#include "../llvmsym/formula/abstract.h"
+#include <sstream>
+#include <vector>
+
+using namespace llvm_sym;
+
+namespace {
+
+typedef Formula::Item Item;
+
+/**
+ * Variables x, y and z of given bit width, z is given by definitions only
+ */
+struct Vars {
+    int bw;
+    Formula::Ident x_id, y_id, z_id;
+    Formula x, y, z;
+
+    explicit Vars( int bw )
+        : bw( bw ), x_id( 0, 0, 0, bw ), y_id( 0, 1, 0, bw ), z_id( 0, 2, 0, bw ),
+          x( Formula::buildIdentifier( x_id ) ), y( Formula::buildIdentifier( y_id ) ),
+          z( Formula::buildIdentifier( z_id ) )
+    {}
+
+    Formula c( int64_t v, int width = 0 ) const {
+        width = width ? width : bw;
+        return Formula::buildConstant( uint64_t( v ) & ( ( 1ull << width ) - 1 ), width );
+    }
+};
+
+struct Constraints {
+    std::vector< Definition > defs;
+    std::vector< Formula > pcs;
+};
+
+/**
+ * Constraints covering the refinement of both sides of comparisons,
+ * signed intervals in one half and across the sign boundary, negations,
+ * conjunctions, disjunctions, definitions and unsatisfiable constraints
+ */
+std::vector< Constraints > environments( const Vars &v )
+{
+    const Formula &x = v.x, &y = v.y, &z = v.z;
+    int64_t max = ( 1ll << v.bw ) - 1;
+    return {
+        { {}, {} },
+        { {}, { x.buildULEq( v.c( 5 ) ) } },
+        { {}, { x.buildUGEq( v.c( 9 ) ) } },
+        { {}, { x > v.c( 2 ), x < v.c( 6 ) } },
+        { {}, { x < v.c( -2 ) } },
+        { {}, { x >= v.c( -3 ), x <= v.c( 2 ) } },
+        { {}, { v.c( 4 ) > x, v.c( -4 ) <= x } },
+        { {}, { x == v.c( 7 ) } },
+        { {}, { x != v.c( 0 ) } },
+        { {}, { x != v.c( max ), x.buildUGEq( v.c( max - 1 ) ) } },
+        { {}, { y.buildUGT( v.c( 0 ) ), y.buildULEq( v.c( 3 ) ) } },
+        { {}, { y < v.c( 0 ) } },
+        { {}, { x == y + v.c( 1 ) } },
+        { {}, { x.buildULEq( y ), y.buildULEq( v.c( 4 ) ) } },
+        { {}, { v.c( 3 ).buildUGT( y ), x.buildUGT( y ) } },
+        { {}, { !x.buildUGEq( v.c( 3 ) ) } },
+        { {}, { !( x.buildULT( v.c( 2 ) ) || y.buildUGT( v.c( 5 ) ) ) } },
+        { {}, { x.buildULT( v.c( 4 ) ) || x.buildUGT( v.c( 12 ) ) } },
+        { {}, { x.buildULT( v.c( 4 ) ) && y.buildUGT( x ) } },
+        { {}, { x.buildUGEq( v.c( max ) ) } },
+        { {}, { x.buildZExt( 2 * v.bw ).buildULEq( v.c( 3, 2 * v.bw ) ) } },
+        { {}, { x.buildULT( y ), y.buildULT( x ) } },
+        { {}, { x.buildULT( v.c( 0 ) ) } },
+        { {}, { x == v.c( 3 ), x == v.c( 4 ) } },
+        { {}, { x < v.c( 0 ), x.buildULT( v.c( 3 ) ) } },
+        { { Definition( v.z_id, x & v.c( 12 ) ) }, {} },
+        { { Definition( v.z_id, x + v.c( 1 ) ) }, { z.buildULEq( v.c( 2 ) ) } },
+        { { Definition( v.z_id, x >> v.c( 1 ) ) }, { z == v.c( 3 ) } },
+        { { Definition( v.z_id, x * v.c( 2 ) ) }, { x.buildULT( v.c( 5 ) ) } },
+        { { Definition( v.z_id, x | v.c( 1 ) ) }, { z == v.c( 4 ) } },
+        { { Definition( v.z_id, y - x ) }, { x.buildULEq( y ) } },
+        { { Definition( v.z_id, x.buildSExt( v.bw + 2 ).buildTrunc( v.bw, 1 ) ) },
+          { x < v.c( 0 ) } }
+    };
+}
+
+/**
+ * Formulas over x and y covering all the operators
+ */
+std::vector< Formula > formulas( const Vars &v )
+{
+    const Formula &x = v.x, &y = v.y;
+    return {
+        x, y, x + y, x - y, x * y, x / y, x.buildSRem( y ), x.buildURem( y ),
+        x & y, x | y, x ^ y, x << v.c( 1 ), x << v.c( v.bw - 1 ), x << v.c( v.bw ),
+        x << y, x >> v.c( 1 ), x >> v.c( v.bw ), x >> y, x.buildBNot(),
+        x.buildZExt( 2 * v.bw ), x.buildSExt( 2 * v.bw ), x.buildTrunc( v.bw - 1, 1 ),
+        x.buildTrunc( v.bw / 2 - 1, 0 ), x.buildConcat( y ), x + v.c( 3 ),
+        x * v.c( 3 ), v.c( 10 ) - x, x / v.c( 2 ), x.buildSRem( v.c( 3 ) ),
+        x.buildURem( v.c( 3 ) ), x.buildURem( v.c( 0 ) ),
+        x == y, x != y, x < y, x <= y, x > y, x >= y,
+        x.buildULT( y ), x.buildULEq( y ), x.buildUGT( y ), x.buildUGEq( y ),
+        x == v.c( 5 ), !x.buildULT( y ), ( x < y ) && y.buildULT( v.c( 5 ) ),
+        ( x < y ) || ( x == v.c( 2 ) ), ( x < y ) ^ ( y < x )
+    };
+}
+
+bool contains( const AbstractValue &a, uint64_t v )
+{
+    if ( a.wide() )
+        return true;
+    return a.lo <= v && v <= a.hi && ( v & a.zeros ) == 0 && ( v & a.ones ) == a.ones;
+}
+
+/**
+ * Concrete solution of the constraints
+ */
+struct Solution {
+    uint64_t x, y, z;
+
+    bool eval( const Formula &f, uint64_t &res ) const {
+        return f.evaluate( res, [&]( const Formula::Ident &id, uint64_t &v, int &bw ) {
+            v = id.off == 0 ? x : id.off == 1 ? y : z;
+            bw = id.bw;
+            return true;
+        } );
+    }
+};
+
+/**
+ * Enumerates all values of x and y, z is given by its definition if any
+ */
+std::vector< Solution > solutions( const Vars &v, const Constraints &c )
+{
+    std::vector< Solution > res;
+    for ( uint64_t x = 0; x != 1ull << v.bw; x++ ) {
+        for ( uint64_t y = 0; y != 1ull << v.bw; y++ ) {
+            Solution s = { x, y, 0 };
+            bool ok = true;
+            for ( const Definition &d : c.defs )
+                ok = ok && s.eval( d.def, s.z );
+            for ( const Formula &pc : c.pcs ) {
+                uint64_t holds;
+                ok = ok && s.eval( pc, holds ) && holds;
+            }
+            if ( ok )
+                res.push_back( s );
+        }
+    }
+    return res;
+}
+
+std::string describe( const Constraints &c )
+{
+    std::ostringstream s;
+    for ( const Definition &d : c.defs )
+        s << d.symbol << " := " << d.def << "; ";
+    for ( const Formula &pc : c.pcs )
+        s << pc << "; ";
+    return s.str();
+}
+
+} // namespace
+
+TEST_CASE( "assume keeps all solutions of the constraints", "[abstract]" ) {
+    for ( int bw : { 4, 6 } ) {
+        Vars v( bw );
+        for ( const Constraints &c : environments( v ) ) {
+            INFO( "bit width " << bw << ": " << describe( c ) );
+            AbstractEnv env;
+            bool satisfiable = env.assume( c.defs, c.pcs );
+            std::vector< Solution > sols = solutions( v, c );
+            if ( !sols.empty() )
+                REQUIRE( satisfiable );
+            if ( !satisfiable )
+                continue;
+
+            for ( const Solution &s : sols ) {
+                INFO( "x = " << s.x << ", y = " << s.y << ", z = " << s.z );
+                REQUIRE( contains( env.get( v.x_id ), s.x ) );
+                REQUIRE( contains( env.get( v.y_id ), s.y ) );
+                if ( !c.defs.empty() )
+                    REQUIRE( contains( env.get( v.z_id ), s.z ) );
+            }
+        }
+    }
+}
+
+TEST_CASE( "unsatisfiable constraints are refuted", "[abstract]" ) {
+    Vars v( 4 );
+    for ( const std::vector< Formula > &pcs : std::vector< std::vector< Formula > >{
+            { v.x.buildULT( v.c( 0 ) ) },
+            { v.x == v.c( 3 ), v.x == v.c( 4 ) },
+            { v.x < v.c( 0 ), v.x.buildULT( v.c( 3 ) ) },
+            { v.x.buildUGT( v.c( 5 ) ), v.x.buildULEq( v.c( 5 ) ) } } )
+    {
+        AbstractEnv env;
+        REQUIRE( !env.assume( {}, pcs ) );
+    }
+}
+
+TEST_CASE( "eval over-approximates the values of formulas", "[abstract]" ) {
+    for ( int bw : { 4, 6 } ) {
+        Vars v( bw );
+        std::vector< Formula > fs = formulas( v );
+        for ( const Constraints &c : environments( v ) ) {
+            AbstractEnv env;
+            if ( !env.assume( c.defs, c.pcs ) )
+                continue;
+            std::vector< Solution > sols = solutions( v, c );
+            for ( const Formula &f : fs ) {
+                AbstractValue a = env.eval( f );
+                INFO( "bit width " << bw << ": " << describe( c ) << "formula " << f
+                    << ": [" << a.lo << ", " << a.hi << "], zeros " << a.zeros
+                    << ", ones " << a.ones );
+                REQUIRE( a.bw == f.bitWidth() );
+                for ( const Solution &s : sols ) {
+                    uint64_t value;
+                    if ( !s.eval( f, value ) )
+                        continue;
+                    INFO( "x = " << s.x << ", y = " << s.y << ", value " << value );
+                    REQUIRE( contains( a, value ) );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "constraints given by reference are assumed the same", "[abstract]" ) {
+    Vars v( 4 );
+    for ( const Constraints &c : environments( v ) ) {
+        std::vector< AbstractEnv::DefinitionRef > defs;
+        for ( const Definition &d : c.defs )
+            defs.emplace_back( d.symbol, &d.def );
+        std::vector< const Formula * > pcs;
+        for ( const Formula &pc : c.pcs )
+            pcs.push_back( &pc );
+
+        AbstractEnv by_value, by_ref;
+        INFO( describe( c ) );
+        REQUIRE( by_value.assume( c.defs, c.pcs ) == by_ref.assume( defs, pcs ) );
+        for ( const Formula::Ident &id : { v.x_id, v.y_id, v.z_id } ) {
+            AbstractValue a = by_value.get( id ), b = by_ref.get( id );
+            REQUIRE( a.lo == b.lo );
+            REQUIRE( a.hi == b.hi );
+            REQUIRE( a.zeros == b.zeros );
+            REQUIRE( a.ones == b.ones );
+        }
+    }
+}
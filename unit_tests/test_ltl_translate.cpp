@@ -0,0 +1,225 @@
+#include <catch/catch.hpp>
+#include "../toolkit/ltl_translate.h"
+#include <memory>
+#include <sstream>
+#include <set>
+
+namespace {
+
+/**
+ * LTL formula over ap1 and ap2 with direct semantics on lasso words
+ */
+struct Ltl {
+    char op; // 'p' proposition, '1' true, '0' false, '!', 'F', 'G', '&', '|', '>', 'U', 'R', 'W'
+    int ap;
+    std::shared_ptr<Ltl> left, right;
+
+    std::string str() const {
+        switch (op) {
+        case 'p': return "ap" + std::to_string(ap);
+        case '1': return "true";
+        case '0': return "false";
+        case '!': return "!(" + left->str() + ")";
+        case 'F': return "F (" + left->str() + ")";
+        case 'G': return "G (" + left->str() + ")";
+        }
+        std::string op_str = op == '&' ? "&&" : op == '|' ? "||" : op == '>' ? "=>"
+            : std::string(1, op);
+        return "(" + left->str() + ") " + op_str + " (" + right->str() + ")";
+    }
+
+    /**
+     * Evaluates formula in all positions of lasso word, letters are bit masks
+     * of propositions (bit 0 for ap1) and position size - 1 is followed by
+     * position loop
+     */
+    std::vector<bool> eval(const std::vector<int>& word, size_t loop) const {
+        size_t n = word.size();
+        auto next = [&](size_t i) { return i + 1 == n ? loop : i + 1; };
+        std::vector<bool> res(n);
+        std::vector<bool> l = left ? left->eval(word, loop) : res;
+        std::vector<bool> r = right ? right->eval(word, loop) : res;
+        // Fixpoints of temporal operators stabilize after n rounds
+        auto fixpoint = [&](bool init, bool until, const std::vector<bool>& a,
+            const std::vector<bool>& b)
+        {
+            std::vector<bool> v(n, init);
+            for (size_t round = 0; round <= n; round++) {
+                for (size_t i = n; i-- > 0; ) {
+                    v[i] = until ? b[i] || (a[i] && v[next(i)])
+                                 : b[i] && (a[i] || v[next(i)]);
+                }
+            }
+            return v;
+        };
+        std::vector<bool> all(n, true), none(n, false);
+        switch (op) {
+        case 'p':
+            for (size_t i = 0; i != n; i++)
+                res[i] = word[i] & (1 << (ap - 1));
+            return res;
+        case '1': return all;
+        case '0': return none;
+        case '!':
+            for (size_t i = 0; i != n; i++)
+                res[i] = !l[i];
+            return res;
+        case 'F': return fixpoint(false, true, all, l);
+        case 'G': return fixpoint(true, false, none, l);
+        case 'U': return fixpoint(false, true, l, r);
+        case 'R': return fixpoint(true, false, l, r);
+        case 'W': {
+            std::vector<bool> lr(n);
+            for (size_t i = 0; i != n; i++)
+                lr[i] = l[i] || r[i];
+            return fixpoint(true, false, r, lr);
+        }
+        }
+        for (size_t i = 0; i != n; i++) {
+            res[i] = op == '&' ? l[i] && r[i]
+                   : op == '|' ? l[i] || r[i]
+                   : !l[i] || r[i];
+        }
+        return res;
+    }
+};
+
+typedef std::shared_ptr<Ltl> F;
+
+F ap(int n) { return F(new Ltl{ 'p', n, nullptr, nullptr }); }
+F con(char c) { return F(new Ltl{ c, 0, nullptr, nullptr }); }
+F un(char op, F f) { return F(new Ltl{ op, 0, f, nullptr }); }
+F bin(F l, char op, F r) { return F(new Ltl{ op, 0, l, r }); }
+
+/**
+ * Evaluates guard of the BA edge on given letter
+ */
+bool guard(const std::string& label, int letter) {
+    std::istringstream s(label);
+    std::string lit;
+    while (s >> lit) {
+        if (lit == "&&" || lit == "1")
+            continue;
+        bool neg = lit[0] == '!';
+        int n = std::stoi(lit.substr(neg ? 3 : 2));
+        if (bool(letter & (1 << (n - 1))) == neg)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Decides if the BA accepts lasso word by searching for an accepting cycle
+ * in the product with the word. As in the model checker, the start vertex
+ * moves to the initial state without reading a letter.
+ */
+bool accepts(const BaDescription& ba, const std::vector<int>& word, size_t loop) {
+    size_t n = word.size();
+    size_t initial = 0;
+    for (const auto& e : ba.edges) {
+        if (e.from == ba.start)
+            initial = e.to;
+    }
+
+    typedef std::pair<size_t, size_t> State; // BA vertex, position
+    auto successors = [&](State s) {
+        std::vector<State> res;
+        for (const auto& e : ba.edges) {
+            if (e.from == s.first && guard(e.label, word[s.second]))
+                res.push_back({ e.to, s.second + 1 == n ? loop : s.second + 1 });
+        }
+        return res;
+    };
+    auto reach = [&](std::vector<State> seeds) {
+        std::set<State> seen;
+        while (!seeds.empty()) {
+            State s = seeds.back();
+            seeds.pop_back();
+            for (State t : successors(s)) {
+                if (seen.insert(t).second)
+                    seeds.push_back(t);
+            }
+        }
+        return seen;
+    };
+
+    std::set<State> reachable = reach({ State(initial, 0) });
+    reachable.insert(State(initial, 0));
+    for (State s : reachable) {
+        if (ba.accepting[s.first] && reach({ s }).count(s))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Compares the language of the translated formula with the semantics on all
+ * lasso words with prefix up to 2 letters and loop up to 2 letters
+ */
+void check_language(F f) {
+    INFO(f->str());
+    BaDescription ba = translate_ltl(f->str());
+    for (size_t prefix = 0; prefix <= 2; prefix++) {
+        for (size_t length = prefix + 1; length <= prefix + 2; length++) {
+            size_t words = size_t(1) << (2 * length);
+            for (size_t code = 0; code != words; code++) {
+                std::vector<int> word;
+                for (size_t i = 0; i != length; i++)
+                    word.push_back((code >> (2 * i)) & 3);
+                bool expected = f->eval(word, prefix)[0];
+                INFO("word code " << code << ", length " << length
+                    << ", loop " << prefix);
+                REQUIRE(accepts(ba, word, prefix) == expected);
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("translated automata accept the language of the formula", "[ltl_translate]") {
+    F a = ap(1), b = ap(2);
+    std::vector<F> formulas = {
+        a, un('!', a), con('1'), con('0'),
+        un('F', a), un('G', a), un('G', un('F', a)), un('F', un('G', a)),
+        bin(a, 'U', b), bin(a, 'R', b), bin(a, 'W', b),
+        bin(a, '&', un('!', b)), bin(a, '|', b), bin(a, '>', b),
+        un('!', bin(a, 'U', b)), un('!', bin(a, 'W', b)),
+        un('G', bin(a, '>', un('F', b))),
+        un('!', bin(un('G', un('F', a)), '>', un('G', un('F', b)))),
+        bin(un('G', un('F', a)), '&', un('G', un('F', b))),
+        un('F', bin(a, '&', un('G', b))),
+        bin(bin(a, 'U', b), 'U', a),
+        bin(a, 'U', bin(un('G', b), '|', un('G', un('!', a)))),
+        un('G', bin(a, 'R', un('F', b))),
+        un('!', un('G', bin(a, '>', bin(b, 'W', un('!', a)))))
+    };
+    for (F f : formulas)
+        check_language(f);
+}
+
+TEST_CASE("unsupported formulas are rejected", "[ltl_translate]") {
+    REQUIRE_THROWS_AS(translate_ltl("X ap1"), LtlTranslateException);
+    REQUIRE_THROWS_AS(translate_ltl("(ap1 U ap2"), LtlTranslateException);
+}
+
+TEST_CASE("automaton description survives save and load", "[ltl_translate]") {
+    BaDescription ba = translate_ltl("G (ap1 => F ap2)");
+    std::stringstream s;
+    ba.save(s);
+    std::string saved = s.str();
+
+    BaDescription loaded;
+    REQUIRE(loaded.load(s));
+    REQUIRE(loaded.start == ba.start);
+    REQUIRE(loaded.accepting == ba.accepting);
+    REQUIRE(loaded.edges.size() == ba.edges.size());
+    for (size_t i = 0; i != ba.edges.size(); i++)
+        REQUIRE(loaded.edges[i].label == ba.edges[i].label);
+
+    // Truncated file, e.g. read while being written, is rejected
+    for (size_t cut : { saved.size() - 2, saved.size() - 6, saved.size() / 2 }) {
+        std::istringstream truncated(saved.substr(0, cut));
+        REQUIRE(!BaDescription().load(truncated));
+    }
+}
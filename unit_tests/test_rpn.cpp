@@ -0,0 +1,321 @@
+#include <catch/catch.hpp>
+#include "../llvmsym/formula/rpn.h"
+#include <vector>
+
+using namespace llvm_sym;
+
+namespace {
+
+typedef Formula::Item Item;
+
+const Formula::Ident x_id( 0, 0, 0, 0 );
+const Formula::Ident y_id( 0, 1, 0, 0 );
+
+Formula var( const Formula::Ident &id, int bw )
+{
+    Formula::Ident i = id;
+    i.bw = bw;
+    return Formula::buildIdentifier( i );
+}
+
+Item op_item( Item::Operator op, int value = 0 )
+{
+    Item i;
+    i.kind = Item::Op;
+    i.op = op;
+    i.value = value;
+    return i;
+}
+
+/**
+ * Builds the formula without the rewriting
+ */
+Formula raw_binary( const Formula &l, const Formula &r, Item::Operator op )
+{
+    Formula f;
+    f._rpn.reserve( l.size() + r.size() + 1 );
+    f.append( l );
+    f.append( r );
+    f.push( op_item( op ) );
+    return f;
+}
+
+Formula raw_unary( const Formula &l, Item::Operator op, int value = 0 )
+{
+    Formula f = l;
+    f.push( op_item( op, value ) );
+    return f;
+}
+
+uint64_t mask( uint64_t v, int bw )
+{
+    return bw >= 64 ? v : v & ( ( 1ull << bw ) - 1 );
+}
+
+int64_t sext( uint64_t v, int bw )
+{
+    return ( v >> ( bw - 1 ) ) & 1 ? int64_t( v | ~( ( 1ull << bw ) - 1 ) ) : int64_t( v );
+}
+
+/**
+ * Evaluates f for given values of x and y
+ */
+bool eval( const Formula &f, uint64_t x, uint64_t y, uint64_t &res )
+{
+    return f.evaluate( res, [&]( const Formula::Ident &id, uint64_t &v, int &bw ) {
+        v = id.off == x_id.off ? x : y;
+        bw = id.bw;
+        return true;
+    } );
+}
+
+/**
+ * Values of x and y to check, all of them for small bit widths
+ */
+std::vector< uint64_t > values( int bw )
+{
+    std::vector< uint64_t > res;
+    if ( bw <= 4 ) {
+        for ( uint64_t v = 0; v != 1ull << bw; v++ )
+            res.push_back( v );
+        return res;
+    }
+    uint64_t min = 1ull << ( bw - 1 );
+    for ( uint64_t v : std::vector< uint64_t >{ 0, 1, 2, 3, 7, min - 1, min, min + 1 } )
+        res.push_back( v );
+    for ( uint64_t v : { 1ull, 2ull } )
+        res.push_back( mask( 0 - v, bw ) );
+    return res;
+}
+
+/**
+ * Checks that the rewritten formula has the value of the original one
+ * wherever the original one is defined
+ */
+void check_rewrite( const Formula &rewritten, const Formula &raw, int bw )
+{
+    INFO( raw << " rewritten to " << rewritten );
+    REQUIRE( rewritten.sane() );
+    REQUIRE( rewritten.bitWidth() == raw.bitWidth() );
+    for ( uint64_t x : values( bw ) ) {
+        for ( uint64_t y : values( bw ) ) {
+            uint64_t expected, actual;
+            if ( !eval( raw, x, y, expected ) )
+                continue;
+            INFO( "x = " << x << ", y = " << y );
+            REQUIRE( eval( rewritten, x, y, actual ) );
+            REQUIRE( actual == expected );
+        }
+    }
+}
+
+/**
+ * Terms of given bit width covering the cases of the rules: variables,
+ * constants 0, 1, -1 and the minimal signed value, composite terms
+ */
+std::vector< Formula > terms( int bw )
+{
+    Formula x = var( x_id, bw ), y = var( y_id, bw );
+    std::vector< Formula > res = { x, y, x + y, x.buildBNot(), x - y };
+    for ( uint64_t c : { 0ull, 1ull, 2ull, 5ull, 1ull << ( bw - 1 ), ~0ull } )
+        res.push_back( Formula::buildConstant( mask( c, bw ), bw ) );
+    return res;
+}
+
+/**
+ * Boolean formulas covering negations and all the comparisons
+ */
+std::vector< Formula > bools( int bw )
+{
+    Formula x = var( x_id, bw ), y = var( y_id, bw );
+    std::vector< Formula > res = {
+        Formula::buildBoolVal( true ), Formula::buildBoolVal( false ),
+        x == y, x != y, x < y, x <= y, x > y, x >= y,
+        x.buildULT( y ), x.buildULEq( y ), x.buildUGT( y ), x.buildUGEq( y ),
+        raw_unary( x == y, Item::Not ), ( x < y ) && ( y == x + x )
+    };
+    return res;
+}
+
+const std::vector< Item::Operator > term_ops = {
+    Item::Plus, Item::Minus, Item::Times, Item::Div, Item::SRem, Item::URem,
+    Item::BAnd, Item::BOr, Item::Xor, Item::Shl, Item::Shr,
+    Item::Eq, Item::NEq, Item::LT, Item::ULT, Item::LEq, Item::ULEq,
+    Item::GT, Item::UGT, Item::GEq, Item::UGEq
+};
+
+const std::vector< Item::Operator > bool_ops = {
+    Item::And, Item::Or, Item::Eq, Item::NEq, Item::Xor
+};
+
+/**
+ * Semantics of the bit-vector operators computed directly, division by zero
+ * is undefined
+ */
+bool reference( Item::Operator op, uint64_t a, uint64_t b, int bw, uint64_t &res )
+{
+    int64_t sa = sext( a, bw ), sb = sext( b, bw );
+    switch ( op ) {
+        case Item::Div:
+            if ( sb == 0 )
+                return false;
+            res = mask( sa / sb, bw );
+            return true;
+        case Item::SRem:
+            if ( sb == 0 )
+                return false;
+            res = mask( sa % sb, bw );
+            return true;
+        case Item::URem:
+            if ( b == 0 )
+                return false;
+            res = a % b;
+            return true;
+        case Item::Plus:  res = mask( a + b, bw ); return true;
+        case Item::Minus: res = mask( a - b, bw ); return true;
+        case Item::Times: res = mask( a * b, bw ); return true;
+        case Item::Shl:   res = b >= uint64_t( bw ) ? 0 : mask( a << b, bw ); return true;
+        case Item::Shr:   res = b >= uint64_t( bw ) ? 0 : a >> b; return true;
+        case Item::LT:    res = sa < sb; return true;
+        case Item::GEq:   res = sa >= sb; return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+TEST_CASE( "evaluation follows the bit-vector semantics", "[rpn]" ) {
+    for ( int bw : { 4, 8 } ) {
+        Formula x = var( x_id, bw ), y = var( y_id, bw );
+        for ( Item::Operator op : { Item::Div, Item::SRem, Item::URem, Item::Plus,
+                                    Item::Minus, Item::Times, Item::Shl, Item::Shr,
+                                    Item::LT, Item::GEq } )
+        {
+            Formula f = raw_binary( x, y, op );
+            for ( uint64_t a = 0; a != 1ull << bw; a++ ) {
+                for ( uint64_t b = 0; b != 1ull << bw; b++ ) {
+                    uint64_t expected, actual;
+                    bool defined = reference( op, a, b, bw, expected );
+                    INFO( f << " for x = " << a << ", y = " << b );
+                    REQUIRE( eval( f, a, b, actual ) == defined );
+                    if ( defined )
+                        REQUIRE( actual == expected );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "division by -1 does not overflow", "[rpn]" ) {
+    for ( int bw : { 4, 8, 64 } ) {
+        uint64_t min = 1ull << ( bw - 1 ), minus_one = mask( ~0ull, bw );
+        Formula m = Formula::buildConstant( min, bw );
+        Formula c = Formula::buildConstant( minus_one, bw );
+        uint64_t res;
+
+        REQUIRE( ( m / c ).evaluate( res ) );
+        REQUIRE( res == min );
+        REQUIRE( m.buildSRem( c ).evaluate( res ) );
+        REQUIRE( res == 0 );
+        REQUIRE( ( m / c ).size() == 1 ); // Folded
+
+        Formula x = var( x_id, bw );
+        check_rewrite( x / c, raw_binary( x, c, Item::Div ), bw );
+        check_rewrite( x.buildSRem( c ), raw_binary( x, c, Item::SRem ), bw );
+    }
+}
+
+TEST_CASE( "binary rewriting preserves the value", "[rpn]" ) {
+    for ( int bw : { 4, 8 } ) {
+        for ( const Formula &l : terms( bw ) ) {
+            for ( const Formula &r : terms( bw ) ) {
+                for ( Item::Operator op : term_ops ) {
+                    Formula f;
+                    if ( Formula::rewriteBinary( l, r, op, f ) )
+                        check_rewrite( f, raw_binary( l, r, op ), bw );
+                }
+            }
+        }
+        for ( const Formula &l : bools( bw ) ) {
+            for ( const Formula &r : bools( bw ) ) {
+                for ( Item::Operator op : bool_ops ) {
+                    Formula f;
+                    if ( Formula::rewriteBinary( l, r, op, f ) )
+                        check_rewrite( f, raw_binary( l, r, op ), bw );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "unary rewriting preserves the value", "[rpn]" ) {
+    for ( int bw : { 4, 8 } ) {
+        for ( const Formula &b : bools( bw ) ) {
+            Formula f;
+            if ( Formula::rewriteUnary( b, Item::Not, 0, f ) )
+                check_rewrite( f, raw_unary( b, Item::Not ), bw );
+            Formula neg = !b;
+            if ( Formula::rewriteUnary( neg, Item::Not, 0, f ) )
+                check_rewrite( f, raw_unary( neg, Item::Not ), bw );
+        }
+
+        for ( const Formula &t : terms( bw ) ) {
+            Formula f;
+            Formula bnot = raw_unary( t, Item::BNot );
+            if ( Formula::rewriteUnary( bnot, Item::BNot, 0, f ) )
+                check_rewrite( f, raw_unary( bnot, Item::BNot ), bw );
+
+            for ( Item::Operator op : { Item::ZExt, Item::SExt } ) {
+                for ( int to : { bw, bw + 4, 2 * bw } ) {
+                    if ( Formula::rewriteUnary( t, op, to, f ) )
+                        check_rewrite( f, raw_unary( t, op, to ), bw );
+                    Formula ext = raw_unary( t, op, bw + 2 );
+                    if ( Formula::rewriteUnary( ext, op, to + 2, f ) )
+                        check_rewrite( f, raw_unary( ext, op, to + 2 ), bw );
+                }
+            }
+
+            for ( int high : { bw - 1, bw / 2 } ) {
+                for ( int low : { 0, 1 } ) {
+                    int value = ( high << 16 ) | low;
+                    if ( Formula::rewriteUnary( t, Item::Trunc, value, f ) )
+                        check_rewrite( f, raw_unary( t, Item::Trunc, value ), bw );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "rules apply to the expected formulas", "[rpn]" ) {
+    Formula x = var( x_id, 8 ), y = var( y_id, 8 );
+    Formula zero = Formula::buildConstant( 0, 8 ), one = Formula::buildConstant( 1, 8 );
+
+    REQUIRE( ( x + zero )._rpn == x._rpn );
+    REQUIRE( ( zero + x )._rpn == x._rpn );
+    REQUIRE( ( x * one )._rpn == x._rpn );
+    REQUIRE( ( x - x )._rpn == zero._rpn );
+    REQUIRE( x.buildSRem( x )._rpn == zero._rpn );
+    REQUIRE( ( x == x )._rpn == Formula::buildBoolVal( true )._rpn );
+    REQUIRE( ( !( x < y ) )._rpn == ( x >= y )._rpn );
+    REQUIRE( ( !!( x == y && y == one ) )._rpn == ( x == y && y == one )._rpn );
+    REQUIRE( ( ( x < y ) && !( x < y ) )._rpn == Formula::buildBoolVal( false )._rpn );
+    REQUIRE( x.buildBNot().buildBNot()._rpn == x._rpn );
+    REQUIRE( x.buildZExt( 8 )._rpn == x._rpn );
+    REQUIRE( x.buildZExt( 16 ).buildZExt( 32 )._rpn == x.buildZExt( 32 )._rpn );
+    REQUIRE( x.buildTrunc( 7, 0 )._rpn == x._rpn );
+    REQUIRE( x.buildTrunc( 3, 0 ).size() == 2 );
+    REQUIRE( ( x / y ).size() == 3 );
+}
+
+TEST_CASE( "items compare by their meaningful fields", "[rpn]" ) {
+    Item a = op_item( Item::Plus, 1 ), b = op_item( Item::Plus, 2 );
+    REQUIRE( a == b ); // Binary operators have no parameter
+
+    Item ext8 = op_item( Item::ZExt, 8 ), ext16 = op_item( Item::ZExt, 16 );
+    REQUIRE( !( ext8 == ext16 ) );
+
+    Formula c4 = Formula::buildConstant( 1, 4 ), c8 = Formula::buildConstant( 1, 8 );
+    REQUIRE( !( c4.top() == c8.top() ) );
+    REQUIRE( c8.top() == Formula::buildConstant( 1, 8 ).top() );
+}